@@ -7,21 +7,91 @@
 #include <fstream>
 #include <iostream>
 #include <cstdarg>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
 #include <vector>
 #include <string>
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Deflate level of the EXR blocks encoded by the current thread, set by the
+// writer of the file before encoding each block
+static thread_local int zipCompressionLevel = -1;
+
 // TinyEXR related defines
+#define TINYEXR_ZIP_COMPRESSION_LEVEL zipCompressionLevel
 #define TINYEXR_IMPLEMENTATION
 #define TINYEXR_USE_MINIZ 1
 #define TINYEXR_USE_THREAD 1
 #include "tinyexr.h"
 
-struct Data {
+// Filters are keyed by the image size they were committed for. Rebinding
+// images of the same size to a committed filter does not re-initialize it, so
+// the weights parsing/reordering and scratch allocation happen only once.
+struct FilterKey {
+    int width;
+    int height;
+
+    bool operator<(const FilterKey &other) const
+    {
+        return std::tie(width, height) < std::tie(other.width, other.height);
+    }
+};
+
+struct CachedFilter {
+    OIDNFilterImpl *filter;
+    uint64_t lastUse; // value of DenoiseContext::useCount when last returned
+};
+
+// A committed filter holds its network and scratch memory, so only the filters
+// of the most recently denoised sizes are kept
+static constexpr size_t maxCachedFilters = 4;
+
+// One OIDN device, i.e. one task arena, with the filters committed on it
+struct DenoiseContext {
     OIDNDeviceImpl *device = nullptr;
+    std::map<FilterKey, CachedFilter> filters;
+    uint64_t useCount = 0;
+};
+
+struct Data {
+    DenoiseContext main;               // uses the whole machine
+    std::vector<DenoiseContext> jobs;  // splits the machine when denoising several files at once
+    int numThreads = 0;                // number of threads of the main device
+    bool int8 = false;                 // int8 inference on the devices
+    std::vector<char> weights;         // weights blob set on the filters, the built-in weights if empty
 } d;
 
+// The pipeline stages print from different threads
+static std::mutex printMutex;
+
 static void printError(const char *msg, ...)
 {
+    std::lock_guard<std::mutex> lock(printMutex);
     va_list arglist;
     va_start(arglist, msg);
     vfprintf(stderr, msg, arglist);
@@ -29,117 +99,1460 @@ static void printError(const char *msg, ...)
     va_end(arglist);
 }
 
-static void toRGBAndAlpha(const float *rgba, std::vector<float> &rgb, std::vector<float> &alpha, int width, int height)
+// Prints a progress line, unless the denoiser it is printed for is set to quiet
+static void printInfo(bool printProgress, const char *msg, ...)
 {
-    const float *inP = rgba;
-    float *outP = rgb.data();
-    float *alphaP = alpha.data();
+    if (!printProgress)
+        return;
+    std::lock_guard<std::mutex> lock(printMutex);
+    va_list arglist;
+    va_start(arglist, msg);
+    vfprintf(stdout, msg, arglist);
+    fputs("\n", stdout);
+    fflush(stdout);
+    va_end(arglist);
+}
+
+// Blocking FIFO with a fixed capacity, used to connect the pipeline stages.
+// close() wakes up all waiters; pop() keeps returning queued items until empty.
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed)
+            return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
 
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            *outP++ = *inP++;
-            *outP++ = *inP++;
-            *outP++ = *inP++;
-            *alphaP++ = *inP++;
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+};
+
+// Persistent threads decoding and encoding the blocks of EXR files. They are
+// started once instead of for every band and take a quarter of the cores,
+// counting the calling thread, because the denoiser runs at the same time.
+class WorkerPool {
+public:
+    WorkerPool()
+    {
+        const int numThreads = std::max(1, int(std::thread::hardware_concurrency()) / 4);
+        for (int t = 1; t < numThreads; ++t)
+            threads.emplace_back([this] { loop(); });
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
         }
+        wakeUp.notify_all();
+        for (auto &t : threads)
+            t.join();
     }
-}
 
-static void combineRGBAndAlpha(const float *rgb, const float *alpha, std::vector<float> &rgba, int width, int height)
-{
-    const float *inP = rgb;
-    const float *alphaP = alpha;
-    float *outP = rgba.data();
+    static WorkerPool &get()
+    {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    // Runs func on every thread of the pool and on the calling one, and waits
+    // for all of them. func is expected to pull its work from a shared counter.
+    void run(const std::function<void()> &func)
+    {
+        std::lock_guard<std::mutex> runLock(runMutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &func;
+            pending = int(threads.size());
+            ++generation;
+        }
+        wakeUp.notify_all();
+        func();
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+        task = nullptr;
+    }
 
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            *outP++ = *inP++;
-            *outP++ = *inP++;
-            *outP++ = *inP++;
-            *outP++ = *alphaP++;
+private:
+    void loop()
+    {
+        uint64_t seenGeneration = 0;
+        for (;;) {
+            const std::function<void()> *func;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [&] { return stop || generation != seenGeneration; });
+                if (stop)
+                    return;
+                seenGeneration = generation;
+                func = task;
+            }
+            (*func)();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0)
+                done.notify_one();
         }
     }
+
+    std::vector<std::thread> threads;
+    std::mutex runMutex;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable done;
+    const std::function<void()> *task = nullptr;
+    uint64_t generation = 0;
+    int pending = 0;
+    bool stop = false;
+};
+
+// Read-only mapping of a whole file. The EXR decoder reads the pages straight
+// from the page cache instead of tinyexr copying the file into a buffer first.
+class MappedFile {
+public:
+    enum class Access { Random, Sequential };
+
+    MappedFile(const std::string &fileName, Access access)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  access == Access::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS,
+                                  nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return;
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping) {
+                ptr = static_cast<const unsigned char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                if (ptr)
+                    length = size_t(fileSize.QuadPart);
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+#else
+        const int fd = open(fileName.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void *p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                ptr = static_cast<const unsigned char *>(p);
+                length = size_t(st.st_size);
+                if (access == Access::Sequential) {
+                    madvise(p, length, MADV_SEQUENTIAL);
+                    madvise(p, length, MADV_WILLNEED);
+                } else
+                    madvise(p, length, MADV_RANDOM);
+            }
+        }
+        close(fd);
+#endif
+    }
+
+    ~MappedFile()
+    {
+        if (!ptr)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(ptr);
+#else
+        munmap(const_cast<unsigned char *>(ptr), length);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isValid() const { return ptr != nullptr; }
+    const unsigned char *data() const { return ptr; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char *ptr = nullptr;
+    size_t length = 0;
+};
+
+// numThreads <= 0 selects the OIDN default (all cores, pinned where possible)
+static DenoiseContext createContext(int numThreads, bool setAffinity)
+{
+    DenoiseContext context;
+    context.device = oidnNewDevice(OIDN_DEVICE_TYPE_CPU);
+    if (numThreads > 0)
+        oidnSetDevice1i(context.device, "numThreads", numThreads);
+    oidnSetDevice1b(context.device, "setAffinity", setAffinity);
+    oidnSetDevice1b(context.device, "int8", d.int8);
+    oidnCommitDevice(context.device);
+    return context;
+}
+
+static void releaseFilters(DenoiseContext &context)
+{
+    for (auto &it : context.filters)
+        oidnReleaseFilter(it.second.filter);
+    context.filters.clear();
+}
+
+static void releaseContext(DenoiseContext &context)
+{
+    releaseFilters(context);
+    oidnReleaseDevice(context.device);
+    context.device = nullptr;
 }
 
 DefaultLightmapDenoiser::DefaultLightmapDenoiser()
 {
-    d.device = oidnNewDevice(OIDN_DEVICE_TYPE_CPU);
-    oidnCommitDevice(d.device);
+    d.main = createContext(0, true);
+    d.numThreads = oidnGetDevice1i(d.main.device, "numThreads");
 }
 
 DefaultLightmapDenoiser::~DefaultLightmapDenoiser()
 {
-    oidnReleaseDevice(d.device);
+    for (DenoiseContext &context : d.jobs)
+        releaseContext(context);
+    d.jobs.clear();
+    releaseContext(d.main);
 }
 
-bool DefaultLightmapDenoiser::process(const std::string &fileName)
+// Returns the contexts for denoising numJobs files concurrently. The threads of
+// the main device are divided evenly between the job devices. Affinity is
+// disabled for these because OIDN pins the threads of every arena starting from
+// the first core, so pinned arenas would all compete for the same cores.
+static std::vector<DenoiseContext> &getJobContexts(int numJobs)
 {
-    std::filesystem::path filePath(fileName);
-    if (filePath.extension() == ".txt")
-        return processListFile(filePath.string());
-    else
-        return denoise(filePath.string());
+    if (int(d.jobs.size()) != numJobs) {
+        for (DenoiseContext &context : d.jobs)
+            releaseContext(context);
+        d.jobs.clear();
+
+        const int numThreads = std::max(d.numThreads / numJobs, 1);
+        for (int i = 0; i < numJobs; ++i)
+            d.jobs.push_back(createContext(numThreads, false));
+    }
+    return d.jobs;
 }
 
-bool DefaultLightmapDenoiser::denoise(const std::string &fileName)
+static OIDNFilter newFilter(OIDNDevice device)
 {
-    float *inOrigData = nullptr;
+    OIDNFilter filter = oidnNewFilter(device, "RTLightmap");
+    oidnSetFilter1b(filter, "hdr", true);
+    if (!d.weights.empty())
+        oidnSetSharedFilterData(filter, "weights", d.weights.data(), d.weights.size());
+    return filter;
+}
+
+static OIDNFilter getFilter(DenoiseContext &context, int width, int height)
+{
+    const FilterKey key = { width, height };
+    auto it = context.filters.find(key);
+    if (it != context.filters.end()) {
+        it->second.lastUse = ++context.useCount;
+        return it->second.filter;
+    }
+
+    // Release the least recently used filter to make room
+    if (context.filters.size() >= maxCachedFilters) {
+        auto lru = std::min_element(context.filters.begin(), context.filters.end(),
+                                    [](const auto &a, const auto &b) { return a.second.lastUse < b.second.lastUse; });
+        oidnReleaseFilter(lru->second.filter);
+        context.filters.erase(lru);
+    }
+
+    OIDNFilter filter = newFilter(context.device);
+    context.filters.emplace(key, CachedFilter { filter, ++context.useCount });
+    return filter;
+}
+
+// Roughly one thread is kept busy per this many pixels of a single image; smaller
+// images leave most of a large machine idle inside one filter execution.
+static constexpr size_t pixelsPerThread = 256 * 256;
+
+// Only the header pages of the mapping are touched
+static bool readImageSize(const std::string &fileName, int &width, int &height)
+{
+    MappedFile file(fileName, MappedFile::Access::Random);
+    if (!file.isValid())
+        return false;
+
+    EXRVersion version;
+    if (ParseEXRVersionFromMemory(&version, file.data(), file.size()) != TINYEXR_SUCCESS)
+        return false;
+
+    EXRHeader header;
+    InitEXRHeader(&header);
+    const char *err = nullptr;
+    if (ParseEXRHeaderFromMemory(&header, &version, file.data(), file.size(), &err) != TINYEXR_SUCCESS) {
+        FreeEXRErrorMessage(err);
+        return false;
+    }
+    width = header.data_window.max_x - header.data_window.min_x + 1;
+    height = header.data_window.max_y - header.data_window.min_y + 1;
+    FreeEXRHeader(&header);
+    return true;
+}
+
+// Picks how many files to denoise concurrently from the median image size, so
+// that each job still gets enough pixels to use its share of the threads.
+static int chooseJobCount(const std::vector<std::string> &fileNames)
+{
+    std::vector<size_t> pixelCounts;
+    for (const std::string &fileName : fileNames) {
+        int width, height;
+        if (readImageSize(fileName, width, height))
+            pixelCounts.push_back(size_t(width) * height);
+    }
+    if (pixelCounts.empty())
+        return 1;
+
+    auto median = pixelCounts.begin() + pixelCounts.size() / 2;
+    std::nth_element(pixelCounts.begin(), median, pixelCounts.end());
+    const int threadsPerImage = int(std::clamp<size_t>(*median / pixelsPerThread, 1, size_t(d.numThreads)));
+    return std::clamp(d.numThreads / threadsPerImage, 1, int(fileNames.size()));
+}
+
+// A lightmap travelling through the load -> denoise -> save stages
+struct LightmapImage {
+    std::string fileName; // absolute path
     int width = 0;
     int height = 0;
+    bool half = false;    // pixels are stored as half floats instead of floats
+    // Interleaved RGBA pixels allocated with malloc. The filter reads and writes
+    // the RGB channels in place, so alpha is kept without splitting the channels.
+    std::unique_ptr<void, void (*)(void *)> pixels { nullptr, free };
+
+    size_t channelSize() const { return half ? sizeof(uint16_t) : sizeof(float); }
+};
+
+// Finds the source channel of R, G, B and A, -1 for a missing alpha. A single
+// channel is replicated like LoadEXR does. Fails unless R, G and B are found and
+// all of them are half or float.
+static bool findRGBAChannels(const EXRHeader &header, int channels[4])
+{
+    std::fill(channels, channels + 4, -1);
+    if (header.num_channels == 1) {
+        std::fill(channels, channels + 4, 0);
+    } else {
+        static const char *const names[4] = { "R", "G", "B", "A" };
+        for (int c = 0; c < header.num_channels; ++c) {
+            for (int i = 0; i < 4; ++i) {
+                if (strcmp(header.channels[c].name, names[i]) == 0)
+                    channels[i] = c;
+            }
+        }
+    }
+
+    bool ok = channels[0] >= 0 && channels[1] >= 0 && channels[2] >= 0;
+    for (int i = 0; ok && i < 4; ++i) {
+        const int c = channels[i];
+        ok = c < 0 || header.pixel_types[c] == TINYEXR_PIXELTYPE_HALF || header.pixel_types[c] == TINYEXR_PIXELTYPE_FLOAT;
+    }
+    return ok;
+}
+
+// Decodes the RGBA channels to interleaved half floats. Half channels are copied
+// as stored, float channels are rounded, so a half EXR never goes through floats.
+static bool decodeEXRHalf(const MappedFile &file, LightmapImage &image)
+{
     const char *err = nullptr;
 
-    // Resolve the file name to an absolute path
-    std::filesystem::path absFilePath = std::filesystem::absolute(fileName);
-    std::string absFileName = absFilePath.string();
+    EXRVersion version;
+    if (ParseEXRVersionFromMemory(&version, file.data(), file.size()) != TINYEXR_SUCCESS) {
+        printError("Failed to load EXR image: Invalid EXR version");
+        return false;
+    }
 
-    std::cout << "Loading EXR image " << absFileName << std::endl;
+    EXRHeader header;
+    InitEXRHeader(&header);
+    if (ParseEXRHeaderFromMemory(&header, &version, file.data(), file.size(), &err) != TINYEXR_SUCCESS) {
+        printError("Failed to load EXR image: %s", err);
+        FreeEXRErrorMessage(err);
+        return false;
+    }
 
-    if (LoadEXR(&inOrigData, &width, &height, absFileName.c_str(), &err) < 0) {
+    EXRImage exrImage;
+    InitEXRImage(&exrImage);
+    if (header.tiled) {
+        printError("Failed to load EXR image: Tiled images are not supported in half mode");
+        FreeEXRHeader(&header);
+        return false;
+    }
+    if (LoadEXRImageFromMemory(&exrImage, &header, file.data(), file.size(), &err) != TINYEXR_SUCCESS) {
         printError("Failed to load EXR image: %s", err);
+        FreeEXRErrorMessage(err);
+        FreeEXRHeader(&header);
         return false;
     }
 
-    std::vector<float> inData(width * height * 3);
-    std::vector<float> alpha(width * height);
-    toRGBAndAlpha(inOrigData, inData, alpha, width, height);
-    free(inOrigData);
+    int channels[4];
+    const bool ok = findRGBAChannels(header, channels);
+    if (ok) {
+        const size_t numPixels = size_t(exrImage.width) * exrImage.height;
+        uint16_t *dst = static_cast<uint16_t *>(malloc(numPixels * 4 * sizeof(uint16_t)));
+        for (int i = 0; i < 4; ++i) {
+            const int c = channels[i];
+            if (c < 0) {
+                const uint16_t one = 0x3C00; // opaque alpha
+                for (size_t p = 0; p < numPixels; ++p)
+                    dst[p * 4 + i] = one;
+            } else if (header.pixel_types[c] == TINYEXR_PIXELTYPE_HALF) {
+                const uint16_t *src = reinterpret_cast<const uint16_t *>(exrImage.images[c]);
+                for (size_t p = 0; p < numPixels; ++p)
+                    dst[p * 4 + i] = src[p];
+            } else {
+                const float *src = reinterpret_cast<const float *>(exrImage.images[c]);
+                for (size_t p = 0; p < numPixels; ++p) {
+                    tinyexr::FP32 f;
+                    f.f = src[p];
+                    dst[p * 4 + i] = tinyexr::float_to_half_full(f).u;
+                }
+            }
+        }
+        image.width = exrImage.width;
+        image.height = exrImage.height;
+        image.pixels.reset(dst);
+    } else {
+        printError("Failed to load EXR image: Unsupported channels");
+    }
 
-    std::vector<float> outData(width * height * 3);
+    FreeEXRImage(&exrImage);
+    FreeEXRHeader(&header);
+    return ok;
+}
 
-    std::cout << "Denoising" << std::endl;
-    OIDNFilter filter = oidnNewFilter(d.device, "RTLightmap");
-    oidnSetSharedFilterImage(filter, "color", inData.data(), OIDN_FORMAT_FLOAT3, width, height, 0, 0, 0);
-    oidnSetSharedFilterImage(filter, "output", outData.data(), OIDN_FORMAT_FLOAT3, width, height, 0, 0, 0);
-    oidnSetFilter1b(filter, "hdr", true);
+static bool loadImage(LightmapImage &image, bool printProgress)
+{
+    float *inOrigData = nullptr;
+    const char *err = nullptr;
+
+    printInfo(printProgress, "Loading EXR image %s", image.fileName.c_str());
+
+    MappedFile file(image.fileName, MappedFile::Access::Sequential);
+    if (!file.isValid()) {
+        printError("Failed to load EXR image: Cannot read file %s", image.fileName.c_str());
+        return false;
+    }
+
+    if (image.half)
+        return decodeEXRHalf(file, image);
+
+    if (LoadEXRFromMemory(&inOrigData, &image.width, &image.height, file.data(), file.size(), &err) < 0) {
+        printError("Failed to load EXR image: %s", err);
+        return false;
+    }
+
+    image.pixels.reset(inOrigData);
+    return true;
+}
+
+// Conversions from the stored channel types to the pixel type of the image
+template<typename T> static T fromHalf(uint16_t h);
+template<> uint16_t fromHalf<uint16_t>(uint16_t h) { return h; }
+template<> float fromHalf<float>(uint16_t h)
+{
+    tinyexr::FP16 f;
+    f.u = h;
+    return tinyexr::half_to_float(f).f;
+}
+
+template<typename T> static T fromFloat(float f);
+template<> uint16_t fromFloat<uint16_t>(float f)
+{
+    tinyexr::FP32 f32;
+    f32.f = f;
+    return tinyexr::float_to_half_full(f32).u;
+}
+template<> float fromFloat<float>(float f) { return f; }
+
+template<typename T> static T opaqueAlpha();
+template<> uint16_t opaqueAlpha<uint16_t>() { return 0x3C00; }
+template<> float opaqueAlpha<float>() { return 1.0f; }
+
+// Decodes ranges of rows of a scanline EXR to interleaved RGBA, with the same
+// channel mapping as loadImage. Only the blocks covering the requested rows are
+// decompressed, so an image larger than memory can be read a band at a time.
+class EXRScanlineReader {
+public:
+    explicit EXRScanlineReader(const MappedFile &file) : file(file)
+    {
+        InitEXRHeader(&header);
+    }
+
+    ~EXRScanlineReader()
+    {
+        if (headerParsed)
+            FreeEXRHeader(&header);
+    }
+
+    EXRScanlineReader(const EXRScanlineReader &) = delete;
+    EXRScanlineReader &operator=(const EXRScanlineReader &) = delete;
+
+    // Parses the header and the offset table, prints the error on failure
+    bool open()
+    {
+        const char *err = nullptr;
+
+        EXRVersion version;
+        if (ParseEXRVersionFromMemory(&version, file.data(), file.size()) != TINYEXR_SUCCESS) {
+            printError("Failed to load EXR image: Invalid EXR version");
+            return false;
+        }
+        if (version.multipart || version.tiled || version.non_image) {
+            printError("Failed to load EXR image: Only single part scanline images can be streamed");
+            return false;
+        }
+        if (ParseEXRHeaderFromMemory(&header, &version, file.data(), file.size(), &err) != TINYEXR_SUCCESS) {
+            printError("Failed to load EXR image: %s", err);
+            FreeEXRErrorMessage(err);
+            return false;
+        }
+        headerParsed = true;
+
+        if (header.tiled || header.line_order != 0) {
+            printError("Failed to load EXR image: Only increasing scanline order can be streamed");
+            return false;
+        }
+        if (!findRGBAChannels(header, channels)) {
+            printError("Failed to load EXR image: Unsupported channels");
+            return false;
+        }
+        size_t channelOffset;
+        if (!tinyexr::ComputeChannelLayout(&channelOffsets, &pixelDataSize, &channelOffset,
+                                           header.num_channels, header.channels)) {
+            printError("Failed to load EXR image: Unsupported channels");
+            return false;
+        }
+
+        imageWidth = header.data_window.max_x - header.data_window.min_x + 1;
+        imageHeight = header.data_window.max_y - header.data_window.min_y + 1;
+        linesPerBlock = tinyexr::NumScanlines(header.compression_type);
+        if (imageWidth <= 0 || imageHeight <= 0) {
+            printError("Failed to load EXR image: Invalid data window");
+            return false;
+        }
+
+        // The offset table follows the header
+        const size_t numBlocks = size_t((imageHeight + linesPerBlock - 1) / linesPerBlock);
+        const size_t tableOffset = 8 + size_t(header.header_len);
+        if (tableOffset + numBlocks * sizeof(uint64_t) > file.size()) {
+            printError("Failed to load EXR image: Insufficient data size in offset table");
+            return false;
+        }
+        offsets.resize(numBlocks);
+        memcpy(offsets.data(), file.data() + tableOffset, numBlocks * sizeof(uint64_t));
+        for (auto &offset : offsets) {
+            tinyexr::swap8(&offset);
+            if (offset > file.size() - 2 * sizeof(int)) {
+                printError("Failed to load EXR image: Invalid offset value");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int width() const { return imageWidth; }
+    int height() const { return imageHeight; }
+
+    // Decodes rows [beginY, endY) to dst, which holds width() * (endY - beginY)
+    // RGBA pixels. The blocks are decoded in parallel.
+    template<typename T>
+    bool readRows(T *dst, int beginY, int endY)
+    {
+        const int firstBlock = beginY / linesPerBlock;
+        const int numBlocks = (endY - 1) / linesPerBlock - firstBlock + 1;
+
+        std::atomic<int> blockCounter(0);
+        std::atomic<bool> failed(false);
+        auto worker = [&]() {
+            std::vector<unsigned char> planes(size_t(pixelDataSize) * imageWidth * linesPerBlock);
+            std::vector<unsigned char *> planePtrs(header.num_channels);
+            int block;
+            while (!failed && (block = blockCounter++) < numBlocks) {
+                const int blockY = (firstBlock + block) * linesPerBlock;
+                const int numLines = std::min(linesPerBlock, imageHeight - blockY);
+
+                // Each channel is decoded to its own plane in the stored type
+                unsigned char *plane = planes.data();
+                for (int c = 0; c < header.num_channels; ++c) {
+                    planePtrs[c] = plane;
+                    plane += (header.pixel_types[c] == TINYEXR_PIXELTYPE_HALF ? 2 : 4) * size_t(imageWidth) * numLines;
+                }
+
+                const uint64_t offset = offsets[firstBlock + block];
+                const unsigned char *data = file.data() + offset;
+                int blockHeader[2];
+                memcpy(blockHeader, data, sizeof(blockHeader));
+                tinyexr::swap4(&blockHeader[0]);
+                tinyexr::swap4(&blockHeader[1]);
+                if (blockHeader[0] != header.data_window.min_y + blockY || blockHeader[1] <= 0 ||
+                    uint64_t(blockHeader[1]) > file.size() - offset - sizeof(blockHeader) ||
+                    !tinyexr::DecodePixelData(planePtrs.data(), header.pixel_types, data + sizeof(blockHeader),
+                                              size_t(blockHeader[1]), header.compression_type, 0,
+                                              imageWidth, numLines, imageWidth, 0, 0, numLines,
+                                              size_t(pixelDataSize), size_t(header.num_custom_attributes),
+                                              header.custom_attributes, size_t(header.num_channels),
+                                              header.channels, channelOffsets)) {
+                    failed = true;
+                    break;
+                }
+
+                // Interleave the requested rows of the block
+                const int rowBegin = std::max(beginY, blockY);
+                const int rowEnd = std::min(endY, blockY + numLines);
+                const size_t srcBegin = size_t(rowBegin - blockY) * imageWidth;
+                const size_t count = size_t(rowEnd - rowBegin) * imageWidth;
+                T *out = dst + size_t(rowBegin - beginY) * imageWidth * 4;
+                for (int i = 0; i < 4; ++i) {
+                    const int c = channels[i];
+                    if (c < 0) {
+                        for (size_t p = 0; p < count; ++p)
+                            out[p * 4 + i] = opaqueAlpha<T>();
+                    } else if (header.pixel_types[c] == TINYEXR_PIXELTYPE_HALF) {
+                        const uint16_t *src = reinterpret_cast<const uint16_t *>(planePtrs[c]) + srcBegin;
+                        for (size_t p = 0; p < count; ++p)
+                            out[p * 4 + i] = fromHalf<T>(src[p]);
+                    } else {
+                        const float *src = reinterpret_cast<const float *>(planePtrs[c]) + srcBegin;
+                        for (size_t p = 0; p < count; ++p)
+                            out[p * 4 + i] = fromFloat<T>(src[p]);
+                    }
+                }
+            }
+        };
+
+        WorkerPool::get().run(worker);
+
+        if (failed) {
+            printError("Failed to load EXR image: Cannot decode rows %d-%d", beginY, endY - 1);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const MappedFile &file;
+    EXRHeader header;
+    bool headerParsed = false;
+    int channels[4];
+    std::vector<size_t> channelOffsets;
+    int pixelDataSize = 0;
+    int imageWidth = 0;
+    int imageHeight = 0;
+    int linesPerBlock = 1;
+    std::vector<tinyexr::tinyexr_uint64> offsets;
+};
+
+// File written at explicit offsets, so blocks can be stored from several
+// threads without sharing a file position.
+class OutputFile {
+public:
+    explicit OutputFile(const std::string &fileName)
+    {
+#ifdef _WIN32
+        file = CreateFileA(fileName.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+        fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    }
+
+    ~OutputFile()
+    {
+        close();
+    }
+
+    OutputFile(const OutputFile &) = delete;
+    OutputFile &operator=(const OutputFile &) = delete;
+
+#ifdef _WIN32
+    bool isValid() const { return file != INVALID_HANDLE_VALUE; }
+#else
+    bool isValid() const { return fd >= 0; }
+#endif
+
+    bool writeAt(const void *data, size_t size, uint64_t offset)
+    {
+        const char *p = static_cast<const char *>(data);
+        while (size > 0) {
+#ifdef _WIN32
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = DWORD(offset);
+            overlapped.OffsetHigh = DWORD(offset >> 32);
+            DWORD written = 0;
+            if (!WriteFile(file, p, DWORD(std::min<size_t>(size, 1u << 30)), &written, &overlapped) || written == 0)
+                return false;
+#else
+            const ssize_t written = pwrite(fd, p, size, off_t(offset));
+            if (written <= 0)
+                return false;
+#endif
+            p += written;
+            size -= size_t(written);
+            offset += uint64_t(written);
+        }
+        return true;
+    }
+
+    bool close()
+    {
+        bool ok = true;
+#ifdef _WIN32
+        if (file != INVALID_HANDLE_VALUE)
+            ok = CloseHandle(file) != 0;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (fd >= 0)
+            ok = ::close(fd) == 0;
+        fd = -1;
+#endif
+        return ok;
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+};
+
+// Writes interleaved RGBA pixels as a 4 channel scanline EXR with the pixel
+// type they are stored in. Same layout as SaveEXR, but the rows are passed in
+// increasing order in any number of calls, and each compressed block is written
+// to the file as soon as the blocks before it are, instead of building the whole
+// file in memory first. The header and offset table are written by finish().
+template<typename T>
+class EXRScanlineWriter {
+public:
+    EXRScanlineWriter(const std::string &fileName, int width, int height, int compressionType, int zipLevel)
+        : fileName(fileName), width(width), height(height), zipLevel(zipLevel), file(fileName)
+    {
+        // No compression for small images
+        if (width < 16 && height < 16)
+            compressionType = TINYEXR_COMPRESSIONTYPE_NONE;
+        this->compressionType = compressionType;
+
+        // ABGR order, which most EXR viewers expect
+        const int pixelType = sizeof(T) == sizeof(uint16_t) ? TINYEXR_PIXELTYPE_HALF : TINYEXR_PIXELTYPE_FLOAT;
+        channels.resize(4);
+        channelOffsets.resize(4);
+        for (int c = 0; c < 4; ++c) {
+            channels[c].name = std::string(1, "ABGR"[c]);
+            channels[c].pixel_type = pixelType;
+            channels[c].requested_pixel_type = pixelType;
+            channels[c].x_sampling = 1;
+            channels[c].y_sampling = 1;
+            channels[c].p_linear = 0;
+            channelOffsets[c] = c * sizeof(T);
+        }
+
+        header = { 0x76, 0x2f, 0x31, 0x01, 2, 0, 0, 0 };
+        {
+            std::vector<unsigned char> data;
+            tinyexr::WriteChannelInfo(data, channels);
+            tinyexr::WriteAttributeToMemory(&header, "channels", "chlist", data.data(), int(data.size()));
+        }
+        {
+            int comp = compressionType;
+            tinyexr::swap4(&comp);
+            tinyexr::WriteAttributeToMemory(&header, "compression", "compression",
+                                            reinterpret_cast<const unsigned char *>(&comp), 1);
+        }
+        {
+            int window[4] = { 0, 0, width - 1, height - 1 };
+            for (int i = 0; i < 4; ++i)
+                tinyexr::swap4(&window[i]);
+            tinyexr::WriteAttributeToMemory(&header, "dataWindow", "box2i",
+                                            reinterpret_cast<const unsigned char *>(window), sizeof(window));
+            tinyexr::WriteAttributeToMemory(&header, "displayWindow", "box2i",
+                                            reinterpret_cast<const unsigned char *>(window), sizeof(window));
+        }
+        {
+            const unsigned char lineOrder = 0; // increasing y
+            tinyexr::WriteAttributeToMemory(&header, "lineOrder", "lineOrder", &lineOrder, 1);
+        }
+        {
+            float aspectRatio = 1.0f;
+            tinyexr::swap4(&aspectRatio);
+            tinyexr::WriteAttributeToMemory(&header, "pixelAspectRatio", "float",
+                                            reinterpret_cast<const unsigned char *>(&aspectRatio), sizeof(float));
+        }
+        {
+            float center[2] = { 0.0f, 0.0f };
+            tinyexr::swap4(&center[0]);
+            tinyexr::swap4(&center[1]);
+            tinyexr::WriteAttributeToMemory(&header, "screenWindowCenter", "v2f",
+                                            reinterpret_cast<const unsigned char *>(center), sizeof(center));
+        }
+        {
+            float windowWidth = 1.0f;
+            tinyexr::swap4(&windowWidth);
+            tinyexr::WriteAttributeToMemory(&header, "screenWindowWidth", "float",
+                                            reinterpret_cast<const unsigned char *>(&windowWidth), sizeof(float));
+        }
+        header.push_back(0); // end of header
+
+        linesPerBlock = tinyexr::NumScanlines(compressionType);
+        offsets.resize((height + linesPerBlock - 1) / linesPerBlock);
+        nextOffset = header.size() + offsets.size() * sizeof(offsets[0]);
+
+        if (!file.isValid())
+            printError("Failed to save EXR image: Cannot write file %s", fileName.c_str());
+    }
+
+    EXRScanlineWriter(const EXRScanlineWriter &) = delete;
+    EXRScanlineWriter &operator=(const EXRScanlineWriter &) = delete;
+
+    bool isValid() const { return file.isValid(); }
+
+    // Rows per compressed block
+    int blockHeight() const { return linesPerBlock; }
+
+    // Encodes rows [beginY, beginY + numRows) from pixels, which holds numRows
+    // rows of RGBA pixels. beginY must be the first row not written yet, and
+    // numRows a multiple of blockHeight() unless the rows end the image.
+    bool writeRows(const T *pixels, int beginY, int numRows)
+    {
+        const int firstBlock = beginY / linesPerBlock;
+        const int endBlock = std::min(int(offsets.size()), (beginY + numRows + linesPerBlock - 1) / linesPerBlock);
+        const int numBlocks = endBlock - firstBlock;
+
+        // Blocks are placed in order: a finished block waits in 'pending' until all
+        // blocks before it have been placed, which keeps the file identical to SaveEXR
+        std::mutex placeMutex;
+        std::vector<std::vector<unsigned char>> pending(numBlocks);
+        int nextBlock = 0;
+
+        std::atomic<int> blockCounter(0);
+        std::atomic<bool> failed(false);
+        auto worker = [&]() {
+            std::vector<T> planes;
+            std::vector<std::pair<uint64_t, std::vector<unsigned char>>> writes;
+            int block;
+            while (!failed && (block = blockCounter++) < numBlocks) {
+                const int blockY = (firstBlock + block) * linesPerBlock;
+                const int numLines = std::min(linesPerBlock, height - blockY);
+                const size_t blockPixels = size_t(width) * numLines;
+                const T *src = pixels + size_t(width) * (blockY - beginY) * 4;
+
+                // Split only this block into planes
+                planes.resize(blockPixels * 4);
+                const T *planePtrs[4];
+                for (int c = 0; c < 4; ++c)
+                    planePtrs[c] = planes.data() + blockPixels * c;
+                for (size_t p = 0; p < blockPixels; ++p) {
+                    planes[p] = src[p * 4 + 3];
+                    planes[blockPixels + p] = src[p * 4 + 2];
+                    planes[blockPixels * 2 + p] = src[p * 4 + 1];
+                    planes[blockPixels * 3 + p] = src[p * 4 + 0];
+                }
+
+                std::vector<unsigned char> data(2 * sizeof(int));
+                zipCompressionLevel = zipLevel;
+                if (!tinyexr::EncodePixelData(data, reinterpret_cast<const unsigned char *const *>(planePtrs),
+                                              compressionType, 0, width, numLines, width, 0, numLines,
+                                              4 * sizeof(T), channels, channelOffsets)) {
+                    failed = true;
+                    break;
+                }
+                int blockHeader[2] = { blockY, int(data.size() - 2 * sizeof(int)) };
+                tinyexr::swap4(&blockHeader[0]);
+                tinyexr::swap4(&blockHeader[1]);
+                memcpy(data.data(), blockHeader, sizeof(blockHeader));
+
+                {
+                    std::lock_guard<std::mutex> lock(placeMutex);
+                    pending[block] = std::move(data);
+                    while (nextBlock < numBlocks && !pending[nextBlock].empty()) {
+                        offsets[firstBlock + nextBlock] = nextOffset;
+                        nextOffset += pending[nextBlock].size();
+                        writes.emplace_back(offsets[firstBlock + nextBlock], std::move(pending[nextBlock]));
+                        pending[nextBlock].clear();
+                        ++nextBlock;
+                    }
+                }
+                for (const auto &write : writes) {
+                    if (!file.writeAt(write.second.data(), write.second.size(), write.first))
+                        failed = true;
+                }
+                writes.clear();
+            }
+        };
+
+        WorkerPool::get().run(worker);
+
+        if (failed) {
+            printError("Failed to save EXR image: Cannot encode or write %s", fileName.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Writes the header and the offset table once all rows have been written
+    bool finish()
+    {
+        for (auto &offset : offsets)
+            tinyexr::swap8(&offset);
+        if (!file.writeAt(header.data(), header.size(), 0) ||
+            !file.writeAt(offsets.data(), offsets.size() * sizeof(offsets[0]), header.size()) ||
+            !file.close()) {
+            printError("Failed to save EXR image: Cannot write file %s", fileName.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::string fileName;
+    int width;
+    int height;
+    int compressionType;
+    int zipLevel;
+    int linesPerBlock;
+    std::vector<tinyexr::ChannelInfo> channels;
+    std::vector<size_t> channelOffsets;
+    std::vector<unsigned char> header;
+    std::vector<tinyexr::tinyexr_uint64> offsets;
+    uint64_t nextOffset = 0;
+    OutputFile file;
+};
+
+template<typename T>
+static bool writeEXR(const LightmapImage &image, int compressionType, int zipLevel, const std::string &fileName)
+{
+    EXRScanlineWriter<T> writer(fileName, image.width, image.height, compressionType, zipLevel);
+    return writer.isValid() &&
+           writer.writeRows(static_cast<const T *>(image.pixels.get()), 0, image.height) &&
+           writer.finish();
+}
+
+static bool denoiseImage(DenoiseContext &context, LightmapImage &image, bool useMask, bool printProgress)
+{
+    const int width = image.width;
+    const int height = image.height;
+    const size_t pixelStride = 4 * image.channelSize();
+    const OIDNFormat format = image.half ? OIDN_FORMAT_HALF3 : OIDN_FORMAT_FLOAT3;
+
+    printInfo(printProgress, "Denoising %s", image.fileName.c_str());
+    // Only the image pointers change for a cached filter, so committing it is cheap
+    OIDNFilter filter = getFilter(context, width, height);
+    oidnSetSharedFilterImage(filter, "color", image.pixels.get(), format, width, height, 0, pixelStride, 0);
+    oidnSetSharedFilterImage(filter, "output", image.pixels.get(), format, width, height, 0, pixelStride, 0);
+    // Texels with zero alpha are not covered by any chart, tiles of only such
+    // texels are copied by the filter instead of denoised
+    if (useMask) {
+        char *alpha = static_cast<char *>(image.pixels.get()) + 3 * image.channelSize();
+        oidnSetSharedFilterImage(filter, "mask", alpha, image.half ? OIDN_FORMAT_HALF : OIDN_FORMAT_FLOAT,
+                                 width, height, 0, pixelStride, 0);
+    } else {
+        oidnRemoveFilterImage(filter, "mask");
+    }
     oidnCommitFilter(filter);
     oidnExecuteFilter(filter);
 
     const char *msg;
-    if (oidnGetDeviceError(d.device, &msg) != OIDN_ERROR_NONE) {
-        std::cerr << "Error from denoiser: " << msg << std::endl;
+    if (oidnGetDeviceError(context.device, &msg) != OIDN_ERROR_NONE) {
+        printError("Error from denoiser: %s", msg);
         return false;
     }
 
-    oidnReleaseFilter(filter);
+    return true;
+}
 
-    std::vector<float> rgba(width * height * 4);
-    combineRGBAndAlpha(outData.data(), alpha.data(), rgba, width, height);
+// Denoised images are written to a temporary file next to the original, on the same
+// file system, which is then renamed over the original. The original is kept if
+// anything fails, and the temporary file is removed.
+static std::filesystem::path getTempFileName(const std::filesystem::path &filePath)
+{
+    std::filesystem::path tempFn = filePath;
+    tempFn += ".tmp";
+    return tempFn;
+}
 
-    std::filesystem::path tempFn = std::filesystem::temp_directory_path() / absFilePath.filename();
-    std::cout << "Saving" << std::endl;
-    if (SaveEXR(rgba.data(), width, height, 4, false, tempFn.string().c_str(), &err) < 0) {
-        printError("Failed to save EXR image: %s", err);
+static bool replaceFile(const std::filesystem::path &tempFn, const std::filesystem::path &filePath, bool ok)
+{
+    std::error_code ec;
+    if (ok) {
+        std::filesystem::rename(tempFn, filePath, ec);
+        if (!ec)
+            return true;
+        printError("Failed to replace %s: %s", filePath.string().c_str(), ec.message().c_str());
+    }
+    std::filesystem::remove(tempFn, ec);
+    return false;
+}
+
+static bool saveImage(const LightmapImage &image, int compressionType, int zipLevel, bool printProgress)
+{
+    std::filesystem::path absFilePath(image.fileName);
+    std::filesystem::path tempFn = getTempFileName(absFilePath);
+    printInfo(printProgress, "Saving %s", image.fileName.c_str());
+    const bool ok = image.half ? writeEXR<uint16_t>(image, compressionType, zipLevel, tempFn.string())
+                               : writeEXR<float>(image, compressionType, zipLevel, tempFn.string());
+    if (!replaceFile(tempFn, absFilePath, ok))
         return false;
+
+    printInfo(printProgress, "Done %s", image.fileName.c_str());
+    return true;
+}
+
+// The stages of a list file update the statistics from different threads
+static std::mutex statisticsMutex;
+
+// Runs one stage of an image and adds its duration to the statistics
+template<typename F>
+static bool timeStage(DefaultLightmapDenoiser::Statistics &stats, double DefaultLightmapDenoiser::Statistics::*stage, F &&func)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const bool ok = func();
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    stats.*stage += duration.count();
+    return ok;
+}
+
+static void countImage(DefaultLightmapDenoiser::Statistics &stats, int width, int height)
+{
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    ++stats.numImages;
+    stats.numPixels += uint64_t(width) * height;
+}
+
+// Memory for the band buffers of streamed denoising. There are two input and two
+// output bands, so the next band is decoded and the previous one encoded while
+// the filter denoises the current one.
+static constexpr size_t streamingBufferBytes = size_t(512) << 20;
+
+// Band heights are a multiple of this, so every band but the last one ends on a
+// block boundary of all EXR compressions
+static constexpr int streamingRowAlignment = 32;
+
+static float toFloat(uint16_t h) { return fromHalf<float>(h); }
+static float toFloat(float f) { return f; }
+
+// Computes the exposure scale of the whole image like the filter does (average
+// log luminance of about 16x16 pixel blocks), reading the rows in bands. Bands
+// denoised with their own automatic exposure could show seams.
+template<typename T>
+static bool computeInputScale(EXRScanlineReader &reader, T *buffer, int bandRows, float &inputScale)
+{
+    constexpr float key = 0.18f;
+    constexpr float eps = 1e-8f;
+    constexpr int K = 16; // downsampling amount
+
+    const int W = reader.width();
+    const int H = reader.height();
+    const int HK = (H + K / 2) / K;
+    const int WK = (W + K / 2) / K;
+    inputScale = 1.0f;
+    if (HK == 0 || WK == 0)
+        return true;
+
+    std::vector<int> blockBegin(WK + 1);
+    for (int j = 0; j <= WK; ++j)
+        blockBegin[j] = int(ptrdiff_t(j) * W / WK);
+
+    // The luminance of a row of blocks is summed row by row as the bands go by
+    std::vector<double> blockSums(WK);
+    int blockRow = 0;
+    int blockRowBegin = 0;
+    int blockRowEnd = int(ptrdiff_t(1) * H / HK);
+    double logSum = 0;
+    int logCount = 0;
+
+    for (int y0 = 0; y0 < H; y0 += bandRows) {
+        const int y1 = std::min(H, y0 + bandRows);
+        if (!reader.readRows(buffer, y0, y1))
+            return false;
+
+        for (int y = y0; y < y1; ++y) {
+            const T *row = buffer + size_t(y - y0) * W * 4;
+            for (int j = 0; j < WK; ++j) {
+                float L = 0;
+                for (int x = blockBegin[j]; x < blockBegin[j + 1]; ++x) {
+                    float c[3];
+                    for (int i = 0; i < 3; ++i) {
+                        const float v = toFloat(row[x * 4 + i]);
+                        c[i] = std::isnan(v) ? 0.0f : std::clamp(v, 0.0f, std::numeric_limits<float>::max());
+                    }
+                    L += 0.212671f * c[0] + 0.715160f * c[1] + 0.072169f * c[2];
+                }
+                blockSums[j] += L;
+            }
+
+            if (y + 1 == blockRowEnd) {
+                for (int j = 0; j < WK; ++j) {
+                    const double numPixels = double(blockRowEnd - blockRowBegin) * (blockBegin[j + 1] - blockBegin[j]);
+                    const float L = float(blockSums[j] / numPixels);
+                    if (L > eps) {
+                        logSum += std::log2(L);
+                        ++logCount;
+                    }
+                    blockSums[j] = 0;
+                }
+                ++blockRow;
+                blockRowBegin = blockRowEnd;
+                blockRowEnd = int(ptrdiff_t(blockRow + 1) * H / HK);
+            }
+        }
+    }
+
+    if (logCount > 0)
+        inputScale = key / std::exp2(float(logSum / logCount));
+    return true;
+}
+
+// Pixel buffer allocated by the denoiser device. Large buffers come from the same
+// pool of huge pages as the filter memory and are reused for the next file once
+// released, instead of being faulted in again for every image.
+template<typename T>
+class DeviceBuffer {
+public:
+    DeviceBuffer() = default;
+    ~DeviceBuffer()
+    {
+        if (buffer)
+            oidnReleaseBuffer(buffer);
     }
 
-    // Replace the original file
-    if (!std::filesystem::remove(absFileName)) {
-        printError("Failed to remove source file");
+    DeviceBuffer(const DeviceBuffer &) = delete;
+    DeviceBuffer &operator=(const DeviceBuffer &) = delete;
+
+    bool allocate(OIDNDevice device, size_t count)
+    {
+        buffer = oidnNewBuffer(device, count * sizeof(T));
+        if (!buffer) {
+            const char *msg;
+            oidnGetDeviceError(device, &msg);
+            printError("Failed to allocate pixel buffer: %s", msg ? msg : "unknown error");
+            return false;
+        }
+        // Fetched once, as oidnGetBufferData locks the device, which a running
+        // filter holds for its whole execution
+        ptr = static_cast<T *>(oidnGetBufferData(buffer));
+        return true;
+    }
+
+    T *data() const { return ptr; }
+
+private:
+    OIDNBuffer buffer = nullptr;
+    T *ptr = nullptr;
+};
+
+// Records when an asynchronous filter execution has completed
+static void onFilterCompleted(void *userPtr, OIDNError, const char *)
+{
+    *static_cast<std::chrono::steady_clock::time_point *>(userPtr) = std::chrono::steady_clock::now();
+}
+
+// Denoises an image too large to keep in memory. The rows are read, denoised and
+// written in bands, each denoised together with the rows of the receptive field
+// above and below it, so the result matches denoising the whole image up to
+// rounding. Memory use is bounded by streamingBufferBytes plus the filter scratch,
+// unless the image is too wide for even four bands of streamingRowAlignment rows.
+template<typename T>
+static bool denoiseStreamed(DenoiseContext &context, const std::string &fileName, int compressionType,
+                            int zipLevel, bool useMask, bool printProgress,
+                            DefaultLightmapDenoiser::Statistics &stats)
+{
+    using Statistics = DefaultLightmapDenoiser::Statistics;
+    using Clock = std::chrono::steady_clock;
+    const bool half = sizeof(T) == sizeof(uint16_t);
+
+    std::filesystem::path absFilePath(fileName);
+    std::filesystem::path tempFn = getTempFileName(absFilePath);
+    int width = 0;
+    int height = 0;
+    bool ok;
+    {
+        printInfo(printProgress, "Streaming EXR image %s", fileName.c_str());
+        MappedFile file(fileName, MappedFile::Access::Sequential);
+        if (!file.isValid()) {
+            printError("Failed to load EXR image: Cannot read file %s", fileName.c_str());
+            return false;
+        }
+        EXRScanlineReader reader(file);
+        if (!reader.open())
+            return false;
+        width = reader.width();
+        height = reader.height();
+
+        // The filter is not cached, its scratch is released with the file
+        std::unique_ptr<OIDNFilterImpl, decltype(&oidnReleaseFilter)> filter(newFilter(context.device),
+                                                                             oidnReleaseFilter);
+
+        // Each band is extended by the overlap of the filter tiles, which covers
+        // the receptive field of the network, and the four band buffers including
+        // this halo are kept within streamingBufferBytes
+        const int overlap = oidnGetFilter1i(filter.get(), "overlap");
+        const size_t rowBytes = size_t(width) * 4 * sizeof(T);
+        const int budgetRows = int(std::min<size_t>(streamingBufferBytes / (4 * rowBytes), size_t(INT_MAX)));
+        int bandRows = std::max((budgetRows - 2 * overlap) / streamingRowAlignment * streamingRowAlignment,
+                                streamingRowAlignment);
+        int maxBandRows = bandRows + 2 * overlap;
+        // An image which fits into a band with its halo is denoised as a single band
+        if (maxBandRows >= height)
+            bandRows = maxBandRows = height;
+        const int numBands = (height + bandRows - 1) / bandRows;
+
+        DeviceBuffer<T> input[2], output[2];
+        for (int i = 0; i < 2; ++i) {
+            if (!input[i].allocate(context.device, size_t(width) * maxBandRows * 4) ||
+                !output[i].allocate(context.device, size_t(width) * maxBandRows * 4))
+                return false;
+        }
+
+        // A single band is denoised with the automatic exposure of the filter,
+        // which gives the same result as the non-streaming path
+        float inputScale = std::numeric_limits<float>::quiet_NaN();
+        if (numBands > 1 &&
+            !timeStage(stats, &Statistics::loadSeconds, [&] { return computeInputScale(reader, input[0].data(), maxBandRows, inputScale); }))
+            return false;
+
+        EXRScanlineWriter<T> writer(tempFn.string(), width, height, compressionType, zipLevel);
+        ok = writer.isValid();
+
+        // Bands start on multiples of streamingRowAlignment, which keeps the filter
+        // tiles on the same pixel grid as when denoising the whole image. The bands
+        // reaching the bottom of the image are moved up to the last aligned start
+        // which still fits into the buffers, and only these have a different height.
+        const int lastBandBegin = std::max((height - maxBandRows + streamingRowAlignment - 1) /
+                                           streamingRowAlignment * streamingRowAlignment, 0);
+        auto bandBegin = [&](int band) { return std::clamp(band * bandRows - overlap, 0, lastBandBegin); };
+        auto bandEnd = [&](int band) { return std::min(bandBegin(band) + maxBandRows, height); };
+        auto readBand = [&](int band) {
+            return timeStage(stats, &Statistics::loadSeconds, [&] {
+                return reader.readRows(input[band % 2].data(), bandBegin(band), bandEnd(band));
+            });
+        };
+        auto writeBand = [&](int band) {
+            const int y0 = band * bandRows;
+            const int numRows = std::min(height, y0 + bandRows) - y0;
+            const T *rows = output[band % 2].data() + size_t(y0 - bandBegin(band)) * width * 4;
+            return timeStage(stats, &Statistics::saveSeconds, [&] { return writer.writeRows(rows, y0, numRows); });
+        };
+
+        ok = ok && readBand(0);
+        for (int band = 0; ok && band < numBands; ++band) {
+            const int rows = bandEnd(band) - bandBegin(band);
+            T *in = input[band % 2].data();
+            T *out = output[band % 2].data();
+            const size_t pixelStride = 4 * sizeof(T);
+            const OIDNFormat format = half ? OIDN_FORMAT_HALF3 : OIDN_FORMAT_FLOAT3;
+
+            oidnSetSharedFilterImage(filter.get(), "color", in, format, width, rows, 0, pixelStride, 0);
+            oidnSetSharedFilterImage(filter.get(), "output", out, format, width, rows, 0, pixelStride, 0);
+            if (useMask) {
+                oidnSetSharedFilterImage(filter.get(), "mask", in + 3, half ? OIDN_FORMAT_HALF : OIDN_FORMAT_FLOAT,
+                                         width, rows, 0, pixelStride, 0);
+            }
+            oidnSetFilter1f(filter.get(), "inputScale", inputScale);
+            oidnCommitFilter(filter.get());
+
+            // The next band is decoded and the previous one encoded while this one
+            // is denoised
+            Clock::time_point start = Clock::now(), end = start;
+            oidnSetFilterCompletionFunction(filter.get(), onFilterCompleted, &end);
+            oidnExecuteFilterAsync(filter.get());
+            if (band + 1 < numBands)
+                ok = readBand(band + 1);
+            if (ok && band > 0)
+                ok = writeBand(band - 1);
+            oidnWaitFilter(filter.get());
+
+            const char *msg;
+            if (oidnGetDeviceError(context.device, &msg) != OIDN_ERROR_NONE) {
+                printError("Error from denoiser: %s", msg);
+                ok = false;
+            }
+            {
+                std::lock_guard<std::mutex> lock(statisticsMutex);
+                stats.denoiseSeconds += std::chrono::duration<double>(end - start).count();
+            }
+
+            // The filter writes only RGB, alpha is copied before the input band is
+            // overwritten by the band after the next one
+            for (size_t p = 0; p < size_t(width) * rows; ++p)
+                out[p * 4 + 3] = in[p * 4 + 3];
+        }
+        if (ok)
+            ok = writeBand(numBands - 1) && timeStage(stats, &Statistics::saveSeconds, [&] { return writer.finish(); });
+    }
+    // Replace the original file once it is no longer mapped
+    if (!replaceFile(tempFn, absFilePath, ok))
         return false;
+
+    countImage(stats, width, height);
+    printInfo(printProgress, "Done %s", fileName.c_str());
+    return true;
+}
+
+void DefaultLightmapDenoiser::setQueueDepth(int depth)
+{
+    queueDepth = std::max(depth, 1);
+}
+
+void DefaultLightmapDenoiser::setJobs(int jobs)
+{
+    numJobs = std::max(jobs, 0);
+}
+
+void DefaultLightmapDenoiser::setHalf(bool half)
+{
+    halfPrecision = half;
+}
+
+void DefaultLightmapDenoiser::setStreaming(bool streaming)
+{
+    this->streaming = streaming;
+}
+
+void DefaultLightmapDenoiser::setUseMask(bool useMask)
+{
+    this->useMask = useMask;
+}
+
+void DefaultLightmapDenoiser::setCompression(Compression compression, int zipLevel)
+{
+    this->compression = compression;
+    this->zipLevel = std::clamp(zipLevel, -1, 9);
+}
+
+bool DefaultLightmapDenoiser::setWeights(const std::string &fileName)
+{
+    std::vector<char> weights;
+    if (!fileName.empty()) {
+        std::ifstream f(fileName, std::ios::binary);
+        if (f.is_open())
+            weights.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+        if (!f.is_open() || f.bad() || weights.empty()) {
+            printError("Cannot read weights file %s", fileName.c_str());
+            return false;
+        }
+    }
+
+    // The cached filters refer to the previous weights
+    releaseFilters(d.main);
+    for (DenoiseContext &context : d.jobs)
+        releaseFilters(context);
+    d.weights = std::move(weights);
+    return true;
+}
+
+void DefaultLightmapDenoiser::setInt8(bool int8)
+{
+    if (int8 == d.int8)
+        return;
+
+    // The devices check whether int8 inference is supported when they are
+    // committed, so they are created again
+    d.int8 = int8;
+    for (DenoiseContext &context : d.jobs)
+        releaseContext(context);
+    d.jobs.clear();
+    releaseContext(d.main);
+    d.main = createContext(0, true);
+    if (int8 && !oidnGetDevice1b(d.main.device, "int8"))
+        printError("int8 inference is not supported by this CPU, using floating-point");
+}
+
+void DefaultLightmapDenoiser::setQuiet(bool quiet)
+{
+    printProgress = !quiet;
+}
+
+DefaultLightmapDenoiser::Statistics DefaultLightmapDenoiser::statistics() const
+{
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    return stats;
+}
+
+void DefaultLightmapDenoiser::resetStatistics()
+{
+    std::lock_guard<std::mutex> lock(statisticsMutex);
+    stats = Statistics();
+}
+
+static int toEXRCompressionType(DefaultLightmapDenoiser::Compression compression)
+{
+    switch (compression) {
+    case DefaultLightmapDenoiser::Compression::None:
+        return TINYEXR_COMPRESSIONTYPE_NONE;
+    case DefaultLightmapDenoiser::Compression::RLE:
+        return TINYEXR_COMPRESSIONTYPE_RLE;
+    case DefaultLightmapDenoiser::Compression::ZIPS:
+        return TINYEXR_COMPRESSIONTYPE_ZIPS;
+    case DefaultLightmapDenoiser::Compression::PIZ:
+        return TINYEXR_COMPRESSIONTYPE_PIZ;
+    case DefaultLightmapDenoiser::Compression::ZIP:
+    default:
+        return TINYEXR_COMPRESSIONTYPE_ZIP;
+    }
+}
+
+bool DefaultLightmapDenoiser::process(const std::string &fileName)
+{
+    std::filesystem::path filePath(fileName);
+    if (filePath.extension() == ".txt")
+        return processListFile(filePath.string());
+    else
+        return denoise(filePath.string());
+}
+
+bool DefaultLightmapDenoiser::denoise(const std::string &fileName)
+{
+    if (streaming) {
+        const std::string absFileName = std::filesystem::absolute(fileName).string();
+        const int compressionType = toEXRCompressionType(compression);
+        return halfPrecision ? denoiseStreamed<uint16_t>(d.main, absFileName, compressionType, zipLevel, useMask, printProgress, stats)
+                             : denoiseStreamed<float>(d.main, absFileName, compressionType, zipLevel, useMask, printProgress, stats);
     }
-    std::filesystem::rename(tempFn, absFileName);
 
-    std::cout << "Done " << absFileName << std::endl;
+    LightmapImage image;
+    image.fileName = std::filesystem::absolute(fileName).string();
+    image.half = halfPrecision;
+
+    const int compressionType = toEXRCompressionType(compression);
+    if (!timeStage(stats, &Statistics::loadSeconds, [&] { return loadImage(image, printProgress); }) ||
+        !timeStage(stats, &Statistics::denoiseSeconds, [&] { return denoiseImage(d.main, image, useMask, printProgress); }) ||
+        !timeStage(stats, &Statistics::saveSeconds, [&] { return saveImage(image, compressionType, zipLevel, printProgress); }))
+        return false;
+
+    countImage(stats, image.width, image.height);
     return true;
 }
 
@@ -151,15 +1564,93 @@ bool DefaultLightmapDenoiser::processListFile(const std::string &fn)
         return false;
     }
 
+    std::vector<std::string> fileNames;
     std::string line;
     while (std::getline(f, line)) {
-        if (!line.empty()) {
-            std::filesystem::path filePath(line);
-            if (!denoise(filePath.string())) {
+        if (!line.empty())
+            fileNames.push_back(std::filesystem::absolute(line).string());
+    }
+
+    // Streamed images are denoised one at a time, each bounding the memory use
+    if (streaming) {
+        for (const std::string &fileName : fileNames) {
+            if (!denoise(fileName))
                 return false;
+        }
+        return true;
+    }
+
+    int jobs = numJobs > 0 ? numJobs : chooseJobCount(fileNames);
+    jobs = std::clamp(jobs, 1, std::max(int(fileNames.size()), 1));
+    if (jobs > 1)
+        printInfo(printProgress, "Denoising %d files concurrently with %d threads each", jobs,
+                  std::max(d.numThreads / jobs, 1));
+
+    // Three-stage pipeline: the reader decodes the next files and the writer
+    // encodes the finished ones while the denoise workers run. With several
+    // workers the files are saved in the order they finish.
+    using ImagePtr = std::unique_ptr<LightmapImage>;
+    BoundedQueue<ImagePtr> loaded(std::max(queueDepth, jobs));
+    BoundedQueue<ImagePtr> denoised(std::max(queueDepth, jobs));
+    std::atomic<bool> failed(false);
+    const int compressionType = toEXRCompressionType(compression);
+
+    std::thread reader([&] {
+        for (const std::string &fileName : fileNames) {
+            ImagePtr image(new LightmapImage);
+            image->fileName = fileName;
+            image->half = halfPrecision;
+            if (failed || !timeStage(stats, &Statistics::loadSeconds, [&] { return loadImage(*image, printProgress); })) {
+                failed = true;
+                break;
+            }
+            if (!loaded.push(std::move(image)))
+                break;
+        }
+        loaded.close();
+    });
+
+    std::thread writer([&] {
+        ImagePtr image;
+        while (denoised.pop(image)) {
+            if (!timeStage(stats, &Statistics::saveSeconds, [&] { return saveImage(*image, compressionType, zipLevel, printProgress); })) {
+                failed = true;
+                break;
             }
+            countImage(stats, image->width, image->height);
         }
+        // Unblock the other stages if we stopped early
+        denoised.close();
+        loaded.close();
+    });
+
+    auto denoiseWorker = [&](DenoiseContext &context) {
+        ImagePtr image;
+        while (!failed && loaded.pop(image)) {
+            if (!timeStage(stats, &Statistics::denoiseSeconds, [&] { return denoiseImage(context, *image, useMask, printProgress); })) {
+                failed = true;
+                break;
+            }
+            if (!denoised.push(std::move(image)))
+                break;
+        }
+        loaded.close();
+    };
+
+    if (jobs == 1) {
+        denoiseWorker(d.main);
+    } else {
+        std::vector<DenoiseContext> &contexts = getJobContexts(jobs);
+        std::vector<std::thread> workers;
+        for (DenoiseContext &context : contexts)
+            workers.emplace_back(denoiseWorker, std::ref(context));
+        for (std::thread &worker : workers)
+            worker.join();
     }
+    denoised.close();
 
-    return true;
-}
\ No newline at end of file
+    reader.join();
+    writer.join();
+
+    return !failed;
+}
@@ -4,21 +4,88 @@
 #ifndef DEFAULTLIGHTMAPDENOISER_H
 #define DEFAULTLIGHTMAPDENOISER_H
 
+#include <cstdint>
 #include <string>
 
 class DefaultLightmapDenoiser {
 
 public:
+    enum class Compression { None, RLE, ZIPS, ZIP, PIZ };
+
+    // Time spent in each stage, summed over the processed images. The stages of
+    // different images overlap when processing a list file.
+    struct Statistics {
+        int numImages = 0;
+        uint64_t numPixels = 0;
+        double loadSeconds = 0;
+        double denoiseSeconds = 0;
+        double saveSeconds = 0;
+    };
+
     DefaultLightmapDenoiser();
     ~DefaultLightmapDenoiser();
 
     bool process(const std::string &fileName);
 
+    // Number of images that may wait between the load, denoise and save
+    // stages when processing a list file
+    void setQueueDepth(int depth);
+
+    // Number of list file entries denoised concurrently, each on its own
+    // device sharing the cores. 0 picks the count from the image sizes.
+    void setJobs(int jobs);
+
+    // Keep the pixels as half floats from decoding to encoding, which halves
+    // the memory traffic and writes fp16 EXR files
+    void setHalf(bool half);
+
+    // Read, denoise and write the images in bands of rows instead of loading
+    // them whole, for lightmaps that do not fit in memory. Only scanline EXR
+    // files can be streamed; list file entries are processed one at a time.
+    void setStreaming(bool streaming);
+
+    // Use the alpha channel as the occupancy mask of the texels. Regions
+    // without any texel of nonzero alpha are left unchanged, which saves
+    // denoising the empty space between the charts of a lightmap.
+    void setUseMask(bool useMask);
+
+    // EXR compression of the written files. zipLevel is the deflate level
+    // (0-9) for ZIP/ZIPS, -1 uses the default. Images smaller than 16x16 are
+    // always written uncompressed.
+    void setCompression(Compression compression, int zipLevel = -1);
+
+    // Denoise with the weights blob (.tza) read from the file instead of the
+    // built-in weights, e.g. weights exported with calibrated int8 scales. An
+    // empty name restores the built-in weights.
+    bool setWeights(const std::string &fileName);
+
+    // Run the convolutions with int8 weights and activations on CPUs with
+    // AVX512-VNNI, if the weights are calibrated for it (see setWeights).
+    // Otherwise floating-point is used; uncalibrated weights are reported
+    // only with OIDN_VERBOSE=1, as the built-in weights are not calibrated.
+    void setInt8(bool int8);
+
+    // Suppresses the per-file progress lines, errors are still printed
+    void setQuiet(bool quiet);
+
+    Statistics statistics() const;
+    void resetStatistics();
+
 protected:
     bool denoise(const std::string &fileName);
 
 private:
     bool processListFile(const std::string &fn);
+
+    int queueDepth = 2;
+    int numJobs = 1;
+    bool halfPrecision = false;
+    bool streaming = false;
+    bool useMask = true;
+    Compression compression = Compression::ZIP;
+    int zipLevel = -1;
+    bool printProgress = true;
+    Statistics stats;
 };
 
 #endif // DEFAULTLIGHTMAPDENOISER_H
@@ -1,8 +1,11 @@
 // Copyright (C) 2024 The Qt Company Ltd.
 // SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <string>
+#include <utility>
 #include <vector>
 #include <OpenImageDenoise/oidn.h>
 #include "defaultlightmapdenoiser.h"
@@ -19,6 +22,15 @@ void showHelp(const std::string &appName)
     std::cout << "Options:\n";
     std::cout << "  -h, --help      Show this help message\n";
     std::cout << "  -v, --version   Show version information\n";
+    std::cout << "  -q, --queue-depth <n>  Images buffered between load/denoise/save (default: 2)\n";
+    std::cout << "  -j, --jobs <n|auto>    Files of a list denoised concurrently (default: 1)\n";
+    std::cout << "      --half             Keep pixels as fp16 from load to save and write fp16 files\n";
+    std::cout << "      --no-mask          Denoise regions with zero alpha too instead of leaving them unchanged\n";
+    std::cout << "      --stream           Read, denoise and write in bands of rows, for images larger than memory\n";
+    std::cout << "  -c, --compression <none|rle|zips|zip|piz>  EXR compression of saved files (default: zip)\n";
+    std::cout << "  -z, --zip-level <0-9>  Deflate level for zip/zips, lower is faster (default: -1, the deflate default level)\n";
+    std::cout << "      --weights <file>   Denoise with the weights from a .tza file instead of the built-in ones\n";
+    std::cout << "      --int8             Use int8 inference on AVX512-VNNI CPUs (needs weights exported with --int8)\n";
     std::cout << "Arguments:\n";
     std::cout << "  file            .exr file or .txt with list of files\n";
 }
@@ -29,6 +41,32 @@ void showVersion()
               << "." << OIDN_VERSION_MINOR << "." << OIDN_VERSION_PATCH << ")\n";
 }
 
+bool parseCompression(const std::string &arg, DefaultLightmapDenoiser::Compression &compression)
+{
+    using Compression = DefaultLightmapDenoiser::Compression;
+    static const std::pair<const char *, Compression> names[] = {
+        { "none", Compression::None },
+        { "rle",  Compression::RLE },
+        { "zips", Compression::ZIPS },
+        { "zip",  Compression::ZIP },
+        { "piz",  Compression::PIZ },
+    };
+    for (const auto &name : names) {
+        if (arg == name.first) {
+            compression = name.second;
+            return true;
+        }
+    }
+    std::cerr << "Unknown compression: " << arg << "\n";
+    return false;
+}
+
+// "auto" maps to 0, which lets the denoiser choose from the image sizes
+int parseJobs(const std::string &arg)
+{
+    return arg == "auto" ? 0 : std::max(std::atoi(arg.c_str()), 1);
+}
+
 #ifdef _WIN32
 std::vector<std::string> getCommandLineArgs()
 {
@@ -54,6 +92,17 @@ int main(int argc, char **argv)
     std::string appName = argv[0];
 #endif
 
+    int queueDepth = 2;
+    int jobs = 1;
+    bool half = false;
+    bool useMask = true;
+    bool streaming = false;
+    DefaultLightmapDenoiser::Compression compression = DefaultLightmapDenoiser::Compression::ZIP;
+    int zipLevel = -1;
+    std::string weights;
+    bool int8 = false;
+    std::vector<std::string> positionalArguments;
+
 #ifdef _WIN32
     for (size_t i = 1; i < args.size(); ++i) {
         if (args[i] == "-h" || args[i] == "--help") {
@@ -62,17 +111,65 @@ int main(int argc, char **argv)
         } else if (args[i] == "-v" || args[i] == "--version") {
             showVersion();
             return EXIT_SUCCESS;
+        } else if (args[i] == "-q" || args[i] == "--queue-depth") {
+            if (++i >= args.size()) {
+                showHelp(appName);
+                return EXIT_FAILURE;
+            }
+            queueDepth = std::atoi(args[i].c_str());
+        } else if (args[i] == "-j" || args[i] == "--jobs") {
+            if (++i >= args.size()) {
+                showHelp(appName);
+                return EXIT_FAILURE;
+            }
+            jobs = parseJobs(args[i]);
+        } else if (args[i] == "--half") {
+            half = true;
+        } else if (args[i] == "--no-mask") {
+            useMask = false;
+        } else if (args[i] == "--stream") {
+            streaming = true;
+        } else if (args[i] == "-c" || args[i] == "--compression") {
+            if (++i >= args.size() || !parseCompression(args[i], compression)) {
+                showHelp(appName);
+                return EXIT_FAILURE;
+            }
+        } else if (args[i] == "-z" || args[i] == "--zip-level") {
+            if (++i >= args.size()) {
+                showHelp(appName);
+                return EXIT_FAILURE;
+            }
+            zipLevel = std::atoi(args[i].c_str());
+        } else if (args[i] == "--weights") {
+            if (++i >= args.size()) {
+                showHelp(appName);
+                return EXIT_FAILURE;
+            }
+            weights = args[i];
+        } else if (args[i] == "--int8") {
+            int8 = true;
+        } else {
+            positionalArguments.emplace_back(args[i]);
         }
     }
 #else
     static struct option long_options[] = {
-        {"help",    no_argument,       nullptr, 'h'},
-        {"version", no_argument,       nullptr, 'v'},
-        {nullptr,   0,                 nullptr,  0 }
+        {"help",        no_argument,       nullptr, 'h'},
+        {"version",     no_argument,       nullptr, 'v'},
+        {"queue-depth", required_argument, nullptr, 'q'},
+        {"jobs",        required_argument, nullptr, 'j'},
+        {"half",        no_argument,       nullptr, 'f'},
+        {"no-mask",     no_argument,       nullptr, 'm'},
+        {"stream",      no_argument,       nullptr, 's'},
+        {"compression", required_argument, nullptr, 'c'},
+        {"zip-level",   required_argument, nullptr, 'z'},
+        {"weights",     required_argument, nullptr, 'w'},
+        {"int8",        no_argument,       nullptr, 'i'},
+        {nullptr,       0,                 nullptr,  0 }
     };
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "hv", long_options, nullptr)) != -1) {
+    while ((opt = getopt_long(argc, argv, "hvq:j:c:z:", long_options, nullptr)) != -1) {
         switch (opt) {
             case 'h':
                 showHelp(appName);
@@ -80,19 +177,42 @@ int main(int argc, char **argv)
             case 'v':
                 showVersion();
                 return EXIT_SUCCESS;
+            case 'q':
+                queueDepth = std::atoi(optarg);
+                break;
+            case 'j':
+                jobs = parseJobs(optarg);
+                break;
+            case 'f':
+                half = true;
+                break;
+            case 'm':
+                useMask = false;
+                break;
+            case 's':
+                streaming = true;
+                break;
+            case 'c':
+                if (!parseCompression(optarg, compression)) {
+                    showHelp(appName);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'z':
+                zipLevel = std::atoi(optarg);
+                break;
+            case 'w':
+                weights = optarg;
+                break;
+            case 'i':
+                int8 = true;
+                break;
             default:
                 showHelp(appName);
                 return EXIT_FAILURE;
         }
     }
-#endif
 
-    std::vector<std::string> positionalArguments;
-#ifdef _WIN32
-    for (size_t i = 1; i < args.size(); ++i) {
-        positionalArguments.emplace_back(args[i]);
-    }
-#else
     for (int i = optind; i < argc; i++) {
         positionalArguments.emplace_back(argv[i]);
     }
@@ -104,6 +224,15 @@ int main(int argc, char **argv)
     }
 
     DefaultLightmapDenoiser denoiser;
+    denoiser.setQueueDepth(queueDepth);
+    denoiser.setJobs(jobs);
+    denoiser.setHalf(half);
+    denoiser.setUseMask(useMask);
+    denoiser.setStreaming(streaming);
+    denoiser.setCompression(compression, zipLevel);
+    denoiser.setInt8(int8);
+    if (!weights.empty() && !denoiser.setWeights(weights))
+        return EXIT_FAILURE;
 
     for (const std::string &fn : positionalArguments) {
         if (!denoiser.process(fn)) {
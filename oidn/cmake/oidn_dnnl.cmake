@@ -53,7 +53,9 @@ file(GLOB DNNL_SOURCES
   mkl-dnn/src/cpu/simple_q10n.hpp
   mkl-dnn/src/cpu/jit_utils/*.[ch]pp
   mkl-dnn/src/cpu/reorder/cpu_reorder.[ch]pp
+  mkl-dnn/src/cpu/reorder/cpu_reorder_regular_f32_bf16.cpp
   mkl-dnn/src/cpu/reorder/cpu_reorder_regular_f32_f32.cpp
+  mkl-dnn/src/cpu/reorder/cpu_reorder_regular_s8.cpp
   mkl-dnn/src/cpu/reorder/simple_reorder.hpp
   mkl-dnn/src/cpu/x64/cpu_barrier.[ch]pp
   mkl-dnn/src/cpu/x64/cpu_isa_traits.[ch]pp
@@ -62,13 +64,22 @@ file(GLOB DNNL_SOURCES
   mkl-dnn/src/cpu/x64/jit_avx2_convolution.[ch]pp
   mkl-dnn/src/cpu/x64/jit_avx512_common_convolution.[ch]pp
   mkl-dnn/src/cpu/x64/jit_avx512_common_conv_kernel.[ch]pp
+  mkl-dnn/src/cpu/x64/jit_avx512_common_convolution_winograd.[ch]pp
+  mkl-dnn/src/cpu/x64/jit_avx512_common_conv_winograd_kernel_f32.[ch]pp
+  mkl-dnn/src/cpu/x64/jit_avx512_core_bf16_conv_kernel.[ch]pp
+  mkl-dnn/src/cpu/x64/jit_avx512_core_bf16_convolution.[ch]pp
   mkl-dnn/src/cpu/x64/jit_avx512_core_bf16cvt.[ch]pp
+  mkl-dnn/src/cpu/x64/jit_avx512_core_f32_wino_conv_4x3.[ch]pp
+  mkl-dnn/src/cpu/x64/jit_avx512_core_f32_wino_conv_4x3_kernel.[ch]pp
+  mkl-dnn/src/cpu/x64/jit_avx512_core_x8s8s32x_conv_kernel.[ch]pp
+  mkl-dnn/src/cpu/x64/jit_avx512_core_x8s8s32x_convolution.[ch]pp
   mkl-dnn/src/cpu/x64/jit_generator.hpp
   mkl-dnn/src/cpu/x64/jit_primitive_conf.hpp
   mkl-dnn/src/cpu/x64/jit_sse41_conv_kernel_f32.[ch]pp
   mkl-dnn/src/cpu/x64/jit_sse41_convolution.[ch]pp
   mkl-dnn/src/cpu/x64/jit_transpose_src_utils.[ch]pp
   mkl-dnn/src/cpu/x64/jit_uni_eltwise.[ch]pp
+  mkl-dnn/src/cpu/x64/jit_uni_i8i8_pooling.[ch]pp
   mkl-dnn/src/cpu/x64/jit_uni_pooling.[ch]pp
   mkl-dnn/src/cpu/x64/jit_uni_pool_kernel.[ch]pp
   mkl-dnn/src/cpu/x64/jit_uni_reorder.[ch]pp
@@ -91,6 +102,7 @@ endif()
 if(CMAKE_CXX_COMPILER_ID STREQUAL "MSVC")
   file(GLOB DNNL_SOURCES_BIGOBJ
     mkl-dnn/src/cpu/cpu_engine.cpp
+    mkl-dnn/src/cpu/reorder/cpu_reorder_regular_f32_bf16.cpp
     mkl-dnn/src/cpu/reorder/cpu_reorder_regular_f32_f32.cpp
     mkl-dnn/src/cpu/cpu_convolution_list.cpp
   )
@@ -7,6 +7,14 @@
   #include "mkl-dnn/src/cpu/x64/xbyak/xbyak_util.h"
 #endif
 
+#if !defined(_WIN32)
+  #include <sys/mman.h>
+  #include <unistd.h>
+  #if defined(__linux__)
+    #include <sys/syscall.h>
+  #endif
+#endif
+
 namespace oidn {
 
   // ---------------------------------------------------------------------------
@@ -43,6 +51,70 @@ namespace oidn {
     #endif
   }
 
+  void* allocPages(size_t size)
+  {
+    if (size == 0)
+      return nullptr;
+
+  #if defined(_WIN32)
+    // Large pages would require the SeLockMemoryPrivilege, so regular pages are used
+    void* ptr = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (ptr == nullptr)
+      throw std::bad_alloc();
+    return ptr;
+  #else
+    // Map an extra huge page and unmap the unaligned head and tail
+    const size_t mapSize = size + hugePageSize;
+    void* mapPtr = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapPtr == MAP_FAILED)
+      throw std::bad_alloc();
+
+    char* begin = (char*)mapPtr;
+    char* ptr = (char*)(((uintptr_t)begin + hugePageSize - 1) & ~(uintptr_t)(hugePageSize - 1));
+    char* end = (char*)(((uintptr_t)ptr + size + getpagesize() - 1) & ~(uintptr_t)(getpagesize() - 1));
+    if (ptr > begin)
+      munmap(begin, ptr - begin);
+    if (begin + mapSize > end)
+      munmap(end, begin + mapSize - end);
+
+  #if defined(MADV_HUGEPAGE)
+    madvise(ptr, size, MADV_HUGEPAGE); // advisory only, failure is not an error
+  #endif
+    return ptr;
+  #endif
+  }
+
+  void freePages(void* ptr, size_t size)
+  {
+    if (ptr == nullptr)
+      return;
+
+  #if defined(_WIN32)
+    VirtualFree(ptr, 0, MEM_RELEASE);
+  #else
+    munmap(ptr, size);
+  #endif
+  }
+
+  int getCurrentNUMANode()
+  {
+  #if defined(_WIN32)
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+    USHORT node;
+    if (!GetNumaProcessorNodeEx(&processor, &node) || node == 0xffff)
+      return 0;
+    return node;
+  #elif defined(__linux__) && defined(SYS_getcpu)
+    unsigned int cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+      return 0;
+    return int(node);
+  #else
+    return 0;
+  #endif
+  }
+
   // ---------------------------------------------------------------------------
   // FP16
   // ---------------------------------------------------------------------------
@@ -174,6 +246,10 @@ namespace oidn {
     case ISA::AVX512_CORE:
       return cpu.has(Cpu::tAVX512F)  && cpu.has(Cpu::tAVX512BW) &&
              cpu.has(Cpu::tAVX512VL) && cpu.has(Cpu::tAVX512DQ);
+    case ISA::AVX512_CORE_VNNI:
+      return isISASupported(ISA::AVX512_CORE) && cpu.has(Cpu::tAVX512_VNNI);
+    case ISA::AVX512_CORE_BF16:
+      return isISASupported(ISA::AVX512_CORE) && cpu.has(Cpu::tAVX512_BF16);
     default:
       return false;
     }
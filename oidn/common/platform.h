@@ -111,6 +111,16 @@ namespace oidn {
   void* alignedMalloc(size_t size, size_t alignment = memoryAlignment);
   void alignedFree(void* ptr);
 
+  constexpr size_t hugePageSize = size_t(2) << 20;
+
+  // Allocates pages directly from the OS, aligned to hugePageSize and backed by transparent huge
+  // pages where supported. The pages are committed only when first touched.
+  void* allocPages(size_t size);
+  void freePages(void* ptr, size_t size);
+
+  // Returns the NUMA node of the processor the calling thread is running on
+  int getCurrentNUMANode();
+
   template<typename T>
   inline std::string toString(const T& a)
   {
@@ -181,7 +191,9 @@ namespace oidn {
   {
     SSE41,
     AVX2,
-    AVX512_CORE
+    AVX512_CORE,
+    AVX512_CORE_VNNI,
+    AVX512_CORE_BF16
   };
 
   bool isISASupported(ISA isa);
@@ -34,6 +34,7 @@
 #include "tbb/parallel_reduce.h"
 #include "tbb/blocked_range.h"
 #include "tbb/blocked_range2d.h"
+#include "tbb/blocked_range3d.h"
 
 namespace oidn {
 
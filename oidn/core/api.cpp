@@ -8,6 +8,13 @@
 #define OIDN_LOCK(obj) \
   std::lock_guard<std::mutex> lock(obj->getDevice()->getMutex());
 
+// Waits for the asynchronous execution of the specified filter and locks the filter
+// (its device unless the filters of the device are concurrent)
+// Use *only* inside OIDN_TRY/CATCH!
+#define OIDN_LOCK_FILTER(filter) \
+  filter->wait();                \
+  std::lock_guard<std::mutex> lock(filter->getMutex());
+
 // Try/catch for converting exceptions to errors
 #define OIDN_TRY \
   try {
@@ -114,6 +121,9 @@ OIDN_API_NAMESPACE_BEGIN
   OIDN_API void oidnReleaseDevice(OIDNDevice hDevice)
   {
     Device* device = (Device*)hDevice;
+    // Pending asynchronous executions keep running with the device until they complete
+    if (device)
+      device->waitAsyncTasks();
     releaseObject(device);
   }
 
@@ -305,7 +315,7 @@ OIDN_API_NAMESPACE_BEGIN
     OIDN_TRY
       checkHandle(hFilter);
       checkHandle(hBuffer);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       Ref<Buffer> buffer = (Buffer*)hBuffer;
       if (buffer->getDevice() != filter->getDevice())
         throw Exception(Error::InvalidArgument, "the specified objects are bound to different devices");
@@ -323,7 +333,7 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       auto image = std::make_shared<Image>(ptr, (Format)format, (int)width, (int)height, byteOffset, bytePixelStride, byteRowStride);
       filter->setImage(name, image);
     OIDN_CATCH(filter)
@@ -334,7 +344,7 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       filter->removeImage(name);
     OIDN_CATCH(filter)
   }
@@ -345,7 +355,7 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       Data data(ptr, byteSize);
       filter->setData(name, data);
     OIDN_CATCH(filter)
@@ -356,7 +366,7 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       filter->updateData(name);
     OIDN_CATCH(filter)
   }
@@ -366,7 +376,7 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       filter->removeData(name);
     OIDN_CATCH(filter)
   }
@@ -376,7 +386,7 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       filter->set1i(name, int(value));
     OIDN_CATCH(filter)
   }
@@ -386,7 +396,7 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       return filter->get1i(name);
     OIDN_CATCH(filter)
     return false;
@@ -397,7 +407,7 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       filter->set1i(name, value);
     OIDN_CATCH(filter)
   }
@@ -407,7 +417,7 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       return filter->get1i(name);
     OIDN_CATCH(filter)
     return 0;
@@ -418,7 +428,7 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       filter->set1f(name, value);
     OIDN_CATCH(filter)
   }
@@ -428,7 +438,7 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       return filter->get1f(name);
     OIDN_CATCH(filter)
     return 0;
@@ -439,7 +449,7 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       filter->setProgressMonitorFunction(func, userPtr);
     OIDN_CATCH(filter)
   }
@@ -449,7 +459,7 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       filter->commit();
     OIDN_CATCH(filter)
   }
@@ -459,9 +469,49 @@ OIDN_API_NAMESPACE_BEGIN
     Filter* filter = (Filter*)hFilter;
     OIDN_TRY
       checkHandle(hFilter);
-      OIDN_LOCK(filter);
+      OIDN_LOCK_FILTER(filter);
       filter->execute();
     OIDN_CATCH(filter)
   }
 
+  OIDN_API void oidnSetFilterCompletionFunction(OIDNFilter hFilter, OIDNCompletionFunction func, void* userPtr)
+  {
+    Filter* filter = (Filter*)hFilter;
+    OIDN_TRY
+      checkHandle(hFilter);
+      OIDN_LOCK_FILTER(filter);
+      filter->setCompletionFunction((CompletionFunction)func, userPtr);
+    OIDN_CATCH(filter)
+  }
+
+  OIDN_API void oidnExecuteFilterAsync(OIDNFilter hFilter)
+  {
+    Filter* filter = (Filter*)hFilter;
+    OIDN_TRY
+      checkHandle(hFilter);
+      OIDN_LOCK_FILTER(filter);
+      filter->executeAsync();
+    OIDN_CATCH(filter)
+  }
+
+  OIDN_API void oidnWaitFilter(OIDNFilter hFilter)
+  {
+    Filter* filter = (Filter*)hFilter;
+    OIDN_TRY
+      checkHandle(hFilter);
+      filter->wait();
+      filter->checkAsyncError();
+    OIDN_CATCH(filter)
+  }
+
+  OIDN_API bool oidnPollFilter(OIDNFilter hFilter)
+  {
+    Filter* filter = (Filter*)hFilter;
+    OIDN_TRY
+      checkHandle(hFilter);
+      return !filter->isPending();
+    OIDN_CATCH(filter)
+    return true;
+  }
+
 OIDN_API_NAMESPACE_END
@@ -45,11 +45,14 @@ namespace oidn {
     ispc::ImageAccessor colorIspc = color;
 
     // Compute the average log luminance of the downsampled image
+    // The summation order must not depend on the scheduling, otherwise the result could change
+    // with the load of the device (e.g. other filters executing concurrently)
     using Sum = std::pair<float, int>;
+    constexpr int grainSize = 8; // in downsampled pixels
 
     Sum sum =
-      tbb::parallel_reduce(
-        tbb::blocked_range2d<int>(0, HK, 0, WK),
+      tbb::parallel_deterministic_reduce(
+        tbb::blocked_range2d<int>(0, HK, grainSize, 0, WK, grainSize),
         Sum(0.f, 0),
         [&](const tbb::blocked_range2d<int>& r, Sum sum) -> Sum
         {
@@ -25,7 +25,9 @@ namespace oidn {
   {
     Float32,
     Float16,
+    BFloat16,
     UInt8,
+    Int8,
   };
 
   template<typename T>
@@ -33,20 +35,43 @@ namespace oidn {
 
   template<> struct DataTypeOf<float>   { static constexpr DataType value = DataType::Float32; };
   template<> struct DataTypeOf<uint8_t> { static constexpr DataType value = DataType::UInt8;   };
+  template<> struct DataTypeOf<int8_t>  { static constexpr DataType value = DataType::Int8;    };
 
   // Returns the size of a data type in bytes
   __forceinline size_t getByteSize(DataType dataType)
   {
     switch (dataType)
     {
-    case DataType::Float32: return 4;
-    case DataType::Float16: return 2;
-    case DataType::UInt8:   return 1;
+    case DataType::Float32:  return 4;
+    case DataType::Float16:  return 2;
+    case DataType::BFloat16: return 2;
+    case DataType::UInt8:    return 1;
+    case DataType::Int8:     return 1;
     default:
       throw Exception(Error::Unknown, "invalid data type");
     }
   }
 
+  // Returns a 64-bit hash of a block of memory (FNV-1a on 64-bit words)
+  inline uint64_t getHash(const void* ptr, size_t size)
+  {
+    constexpr uint64_t prime = 0x100000001b3ull;
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    const char* bytes = (const char*)ptr;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+      uint64_t word;
+      memcpy(&word, bytes + i, sizeof(uint64_t));
+      hash = (hash ^ word) * prime;
+    }
+    for (; i < size; ++i)
+      hash = (hash ^ uint8_t(bytes[i])) * prime;
+
+    return hash;
+  }
+
   // Returns the size of a format in bytes
   __forceinline size_t getByteSize(Format format)
   {
@@ -126,4 +151,20 @@ namespace oidn {
     });
   }
 
+  template <typename T0, typename T1, typename T2, typename F>
+  __forceinline void parallel_nd(const T0& D0, const T1& D1, const T2& D2, F f)
+  {
+    tbb::parallel_for(tbb::blocked_range3d<T0, T1, T2>(0, D0, 0, D1, 0, D2), [&](const tbb::blocked_range3d<T0, T1, T2>& r)
+    {
+      for (T0 i = r.pages().begin(); i != r.pages().end(); ++i)
+      {
+        for (T1 j = r.rows().begin(); j != r.rows().end(); ++j)
+        {
+          for (T2 k = r.cols().begin(); k != r.cols().end(); ++k)
+            f(i, j, k);
+        }
+      }
+    });
+  }
+
 } // namespace oidn
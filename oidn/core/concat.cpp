@@ -0,0 +1,80 @@
+// Copyright 2009-2021 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "concat.h"
+
+namespace oidn {
+
+  ConcatNode::ConcatNode(const Ref<Device>& device,
+                         const std::string& name,
+                         const std::shared_ptr<Tensor>& src,
+                         const std::shared_ptr<Tensor>& dst,
+                         int dstChannelOffset)
+    : Node(device, name),
+      src(src),
+      dst(dst),
+      dstChannelOffset(dstChannelOffset)
+  {
+    assert(dst->ndims() == src->ndims());
+    assert(dst->layout == src->layout);
+    assert(dst->dataType == src->dataType);
+    assert(dst->scale == src->scale);
+    assert(dst->batchSize() == src->batchSize());
+    assert(dst->height() == src->height());
+    assert(dst->width() == src->width());
+    assert(dstChannelOffset % src->blockSize() == 0);
+    assert(dstChannelOffset + src->numChannels() <= dst->numChannels());
+  }
+
+  void ConcatNode::execute()
+  {
+    if (src->layout == TensorLayout::hwc)
+    {
+      executeHWC();
+      return;
+    }
+
+    const int K = src->blockSize();
+    const size_t blockByteSize = size_t(src->height()) * src->width() * K * src->elementByteSize();
+    const size_t srcItemByteSize = src->byteSize() / src->batchSize();
+    const size_t dstItemByteSize = dst->byteSize() / dst->batchSize();
+    const size_t dstByteOffset = size_t(dstChannelOffset / K) * blockByteSize;
+
+    const char* srcPtr = (const char*)src->data();
+    char* dstPtr = (char*)dst->data();
+
+    // The channel blocks of an item are stored contiguously in both tensors
+    parallel_nd(src->batchSize(), src->numChannelBlocks(), [&](int n, int cb)
+    {
+      memcpy(dstPtr + n * dstItemByteSize + dstByteOffset + cb * blockByteSize,
+             srcPtr + n * srcItemByteSize + cb * blockByteSize,
+             blockByteSize);
+    });
+  }
+
+  void ConcatNode::executeHWC()
+  {
+    const size_t srcPixelByteSize = src->numChannels() * src->elementByteSize();
+    const size_t dstPixelByteSize = dst->numChannels() * dst->elementByteSize();
+    const size_t srcItemByteSize = src->byteSize() / src->batchSize();
+    const size_t dstItemByteSize = dst->byteSize() / dst->batchSize();
+    const size_t dstByteOffset = dstChannelOffset * dst->elementByteSize();
+
+    const char* srcPtr = (const char*)src->data();
+    char* dstPtr = (char*)dst->data();
+
+    // The channels are interleaved, so each pixel is copied separately
+    parallel_nd(src->batchSize(), src->height(), [&](int n, int h)
+    {
+      const size_t begin = h * size_t(src->width());
+      const size_t end = begin + src->width();
+      for (size_t i = begin; i < end; ++i)
+      {
+        memcpy(dstPtr + n * dstItemByteSize + i * dstPixelByteSize + dstByteOffset,
+               srcPtr + n * srcItemByteSize + i * srcPixelByteSize,
+               srcPixelByteSize);
+      }
+    });
+  }
+
+} // namespace oidn
@@ -0,0 +1,37 @@
+// Copyright 2009-2021 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "node.h"
+
+namespace oidn {
+
+  // Concatenation node: copies the source into a channel range of the destination
+  // for each batch item. Single-item networks concatenate tensors by placing them
+  // next to each other in memory instead, which is not possible with batches or
+  // with the interleaved channels of the HWC layout.
+  class ConcatNode : public Node
+  {
+  private:
+    std::shared_ptr<Tensor> src;
+    std::shared_ptr<Tensor> dst;
+    int dstChannelOffset;
+
+  public:
+    ConcatNode(const Ref<Device>& device,
+               const std::string& name,
+               const std::shared_ptr<Tensor>& src,
+               const std::shared_ptr<Tensor>& dst,
+               int dstChannelOffset);
+
+    void execute() override;
+
+    std::shared_ptr<Tensor> getDst() const override { return dst; }
+    double getByteCount() const override { return 2. * src->byteSize(); }
+
+  private:
+    void executeHWC();
+  };
+
+} // namespace oidn
@@ -0,0 +1,831 @@
+// Copyright 2009-2021 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "conv.h"
+#include <chrono>
+
+namespace oidn {
+
+#if defined(OIDN_DNNL)
+
+  namespace
+  {
+    // Returns the name of the implementation of a primitive (e.g. "jit_wino_4x3:avx512_core")
+    std::string getImplInfo(const dnnl::primitive_desc_base& primDesc)
+    {
+      const char* info = nullptr;
+      if (dnnl_primitive_desc_query(primDesc.get(), dnnl_query_impl_info_str, 0, &info) != dnnl_success || !info)
+        return "";
+      return info;
+    }
+
+    std::string toString(const dnnl::memory::dims& dims)
+    {
+      std::string str;
+      for (size_t i = 0; i < dims.size(); ++i)
+        str += (i > 0 ? "x" : "") + std::to_string(dims[i]);
+      return str;
+    }
+
+    dnnl::convolution_forward::primitive_desc getConvPrimDesc(const Ref<Device>& device,
+                                                              dnnl::algorithm algo,
+                                                              const dnnl::memory::desc& srcDesc,
+                                                              const TensorDims& weightsDims,
+                                                              const TensorDims& biasDims,
+                                                              const dnnl::memory::desc& dstDesc,
+                                                              const dnnl::memory::dims& paddingL,
+                                                              const dnnl::memory::dims& paddingR,
+                                                              bool relu,
+                                                              const std::vector<float>& outputScales)
+    {
+      const dnnl::memory::dims strides = {1, 1};
+
+      // Let the convolution primitive choose the weights format (the weights
+      // have the same data type as the source, except for quantized convolutions)
+      const bool quantized = !outputScales.empty();
+      auto weightsDesc = dnnl::memory::desc({ weightsDims },
+                                            quantized ? dnnl::memory::data_type::s8
+                                                      : srcDesc.data_type(),
+                                            dnnl::memory::format_tag::any);
+
+      // Let the convolution primitive choose the bias format (the bias is kept
+      // in f32 even for bf16 tensors, which are accumulated in f32 anyway)
+      // A zero descriptor disables the bias
+      dnnl::memory::desc biasDesc;
+      if (!biasDims.empty())
+        biasDesc = dnnl::memory::desc({ biasDims },
+                                      dnnl::memory::data_type::f32,
+                                      dnnl::memory::format_tag::any);
+
+      auto convDesc = dnnl::convolution_forward::desc(
+        dnnl::prop_kind::forward_inference, algo,
+        srcDesc,
+        weightsDesc,
+        biasDesc,
+        dstDesc,
+        strides, paddingL, paddingR);
+
+      // Incorporate relu
+      dnnl::primitive_attr convAttr;
+      if (relu)
+      {
+        dnnl::post_ops ops;
+        ops.append_eltwise(
+          1.f,   // scale
+          dnnl::algorithm::eltwise_relu,
+          0.f,   // alpha
+          0.f    // beta
+        );
+        convAttr.set_post_ops(ops);
+      }
+      if (quantized)
+        convAttr.set_output_scales(1 << 1, outputScales); // per output channel
+      convAttr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
+
+      return dnnl::convolution_forward::primitive_desc(convDesc, convAttr, device->getDNNLEngine());
+    }
+
+    // Returns the tensor in the specified format, reordering it if necessary
+    std::shared_ptr<Tensor> reorder(const Ref<Device>& device,
+                                    const std::shared_ptr<Tensor>& src,
+                                    const dnnl::memory::desc& dstDesc)
+    {
+      if (src->mem.get_desc() == dstDesc)
+        return src;
+
+      auto dst = std::make_shared<Tensor>(device, dstDesc);
+      ReorderNode(device, "reorder", src, dst).execute();
+      device->wait();
+      return dst;
+    }
+
+    // Returns the weights (or bias) of a convolution in the specified format, which are
+    // shared by all filters of the device with the same weights key (if not empty)
+    std::shared_ptr<Tensor> getWeights(const Ref<Device>& device,
+                                       const std::string& weightsKey,
+                                       const std::string& name,
+                                       const std::function<std::shared_ptr<Tensor>()>& getSrc,
+                                       const dnnl::memory::desc& desc)
+    {
+      if (weightsKey.empty())
+        return reorder(device, getSrc(), desc);
+
+      // The key includes the format, which depends on the ISA and data type
+      std::string key = weightsKey + "/" + name + "/";
+      key.append((const char*)&desc.data, sizeof(desc.data));
+
+      return device->getCachedWeights(key, [&]()
+      {
+        auto src = getSrc();
+        auto dst = reorder(device, src, desc);
+
+        // The cached weights may outlive the weights blob of the filter, so they must be copied
+        if (dst == src)
+        {
+          dst = std::make_shared<Tensor>(device, desc);
+          memcpy(dst->data(), src->data(), desc.get_size());
+        }
+
+        return dst;
+      });
+    }
+
+    std::shared_ptr<Tensor> getWeights(const Ref<Device>& device,
+                                       const std::string& weightsKey,
+                                       const std::string& name,
+                                       const std::shared_ptr<Tensor>& src,
+                                       const dnnl::memory::desc& desc)
+    {
+      return getWeights(device, weightsKey, name, [&]() { return src; }, desc);
+    }
+
+    // Returns the number of channels per block in the layout of a tensor
+    int getBlockC(const Tensor& tensor)
+    {
+      return (tensor.layout == TensorLayout::hwc) ? tensor.numChannels() : tensor.blockSize();
+    }
+
+    // Returns rows [y0, y1) of a batch item of a tensor as a dense tensor, which is either
+    // the original memory (if there is a single channel block) or a copy in the band buffer
+    void* getRows(const Tensor& src, int n, int y0, int y1, char* band)
+    {
+      const int H = src.height();
+      const int blockC = getBlockC(src);
+      const int numBlocks = src.numChannels() / blockC;
+      const size_t rowByteSize = size_t(src.width()) * blockC * src.elementByteSize();
+      const char* srcPtr = (const char*)src.data() + size_t(n) * numBlocks * H * rowByteSize;
+
+      if (numBlocks == 1)
+        return (void*)(srcPtr + y0 * rowByteSize);
+
+      const size_t bandBlockByteSize = (y1 - y0) * rowByteSize;
+      parallel_nd(numBlocks, [&](int cb)
+      {
+        memcpy(band + cb * bandBlockByteSize,
+               srcPtr + (size_t(cb) * H + y0) * rowByteSize,
+               bandBlockByteSize);
+      });
+      return band;
+    }
+
+    // Returns the number of rows per band for the size of an output row of a band
+    int getBandH(size_t rowByteSize)
+    {
+      // The bands should fit in the cache but have enough rows to keep all threads busy
+      constexpr size_t targetBandByteSize = 1024 * 1024;
+      const int bandH = int(targetBandByteSize / rowByteSize);
+      return max(bandH, 2 * tbb::this_task_arena::max_concurrency());
+    }
+
+    // Converts a float to bfloat16 (round to nearest even)
+    __forceinline uint16_t toBF16(float x)
+    {
+      uint32_t u;
+      memcpy(&u, &x, sizeof(float));
+      u += 0x7FFF + ((u >> 16) & 1);
+      return uint16_t(u >> 16);
+    }
+  }
+
+  ConvNode::ConvNode(const Ref<Device>& device,
+                     const std::string& name,
+                     const std::shared_ptr<Tensor>& src,
+                     const std::shared_ptr<Tensor>& weights,
+                     const std::shared_ptr<Tensor>& bias,
+                     const std::shared_ptr<Tensor>& dst,
+                     bool relu,
+                     const std::vector<float>& outputScales,
+                     const std::string& weightsKey)
+    : DNNLNode(device, name),
+      src(src), weights(weights), bias(bias), dst(dst), relu(relu)
+  {
+    const dnnl::memory::dims padding = {1, 1};
+    auto getPrimDesc = [&](dnnl::algorithm algo)
+    {
+      return getConvPrimDesc(device, algo, src->mem.get_desc(), weights->dims, bias->dims,
+                             dst->mem.get_desc(), padding, padding, relu, outputScales);
+    };
+
+    auto convPrimDesc = getPrimDesc(dnnl::algorithm::convolution_direct);
+
+    // Winograd convolutions are implemented only for some data types, ISAs and shapes,
+    // otherwise the layer falls back to direct convolution
+    const ConvAlgo algo = device->getConvAlgo();
+    if (algo != ConvAlgo::Direct && outputScales.empty())
+    {
+      dnnl::convolution_forward::primitive_desc winogradPrimDesc;
+      try
+      {
+        winogradPrimDesc = getPrimDesc(dnnl::algorithm::convolution_winograd);
+      }
+      catch (const dnnl::error&) {}
+
+      if (winogradPrimDesc &&
+          (algo == ConvAlgo::Winograd || isWinogradFaster(convPrimDesc, winogradPrimDesc)))
+        convPrimDesc = winogradPrimDesc;
+    }
+
+    if (device->isVerbose(3))
+      std::cout << "Convolution " << name << ": " << getImplInfo(convPrimDesc) << std::endl;
+
+    // Reorder the weights and bias to the final format, if necessary
+    this->weights = getWeights(device, weightsKey, name + ".weight", weights, convPrimDesc.weights_desc());
+    this->bias = getWeights(device, weightsKey, name + ".bias", bias, convPrimDesc.bias_desc());
+
+    prim = dnnl::convolution_forward(convPrimDesc);
+    args = {{DNNL_ARG_SRC,     src->mem},
+            {DNNL_ARG_WEIGHTS, this->weights->mem},
+            {DNNL_ARG_BIAS,    this->bias->mem},
+            {DNNL_ARG_DST,     dst->mem}};
+  }
+
+  // Benchmarks both algorithms for the shape of the convolution, unless it was done already
+  bool ConvNode::isWinogradFaster(const dnnl::convolution_forward::primitive_desc& directPrimDesc,
+                                  const dnnl::convolution_forward::primitive_desc& winogradPrimDesc)
+  {
+    // The implementations identify the ISA too
+    const std::string key = toString(src->mem.get_desc().dims()) + ":" +
+                            toString(dst->mem.get_desc().dims()) + ":" +
+                            std::to_string(relu) + ":" +
+                            getImplInfo(directPrimDesc) + ":" + getImplInfo(winogradPrimDesc);
+
+    const auto algo = device->getCachedConvAlgo(key, [&]()
+    {
+      const double directTime   = benchmark(directPrimDesc);
+      const double winogradTime = benchmark(winogradPrimDesc);
+
+      if (device->isVerbose(2))
+      {
+        std::cout << "Convolution " << name << ": direct " << directTime * 1000. << " ms, "
+                  << "Winograd " << winogradTime * 1000. << " ms" << std::endl;
+      }
+
+      return winogradTime < directTime ? dnnl::algorithm::convolution_winograd
+                                       : dnnl::algorithm::convolution_direct;
+    });
+
+    return algo == dnnl::algorithm::convolution_winograd;
+  }
+
+  // Returns the fastest of a few executions of a convolution in seconds
+  // The source and destination are in the scratch buffer, which is not in use while building
+  // the network, the rest of the arguments are temporary. The source is zeroed because the
+  // uninitialized memory may contain denormals or NaNs, which would slow down the runs.
+  double ConvNode::benchmark(const dnnl::convolution_forward::primitive_desc& primDesc)
+  {
+    memset(src->data(), 0, src->mem.get_desc().get_size());
+
+    auto weights = reorder(device, this->weights, primDesc.weights_desc());
+    auto bias = reorder(device, this->bias, primDesc.bias_desc());
+    auto scratchpad = std::make_shared<Tensor>(device, primDesc.scratchpad_desc());
+
+    dnnl::convolution_forward prim(primDesc);
+    std::unordered_map<int, dnnl::memory> args = {
+      {DNNL_ARG_SRC,        src->mem},
+      {DNNL_ARG_WEIGHTS,    weights->mem},
+      {DNNL_ARG_BIAS,       bias->mem},
+      {DNNL_ARG_DST,        dst->mem},
+      {DNNL_ARG_SCRATCHPAD, scratchpad->mem}};
+
+    constexpr int numRuns = 2;
+    double minTime = std::numeric_limits<double>::infinity();
+    for (int i = 0; i <= numRuns; ++i)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      prim.execute(device->getDNNLStream(), args);
+      device->wait();
+      const auto end = std::chrono::steady_clock::now();
+      if (i > 0) // the first run is a warm-up
+        minTime = min(minTime, std::chrono::duration<double>(end - start).count());
+    }
+
+    return minTime;
+  }
+
+  ConvPoolNode::ConvPoolNode(const Ref<Device>& device,
+                             const std::string& name,
+                             const std::shared_ptr<Tensor>& src,
+                             const std::shared_ptr<Tensor>& weights,
+                             const std::shared_ptr<Tensor>& bias,
+                             const std::shared_ptr<Tensor>& dst,
+                             const std::vector<float>& outputScales,
+                             const std::string& weightsKey)
+    : Node(device, name),
+      src(src), dst(dst)
+  {
+    C  = src->numChannels();
+    H  = src->height();
+    W  = src->width();
+    OC = dst->numChannels();
+    assert(H % 2 == 0 && W % 2 == 0);
+    assert(dst->height() == H/2 && dst->width() == W/2);
+
+    dstBlockC = getBlockC(*dst);
+
+    bandH = min(round_up(getBandH(size_t(OC) * W * dst->elementByteSize()), 2), H);
+
+    // Create the convolutions for all band shapes, which differ only in the first and last bands
+    for (int y0 = 0; y0 < H; y0 += bandH)
+    {
+      const int y1 = min(y0 + bandH, H);
+      const int padTop    = (y0 == 0) ? 1 : 0;
+      const int padBottom = (y1 == H) ? 1 : 0;
+
+      bool found = false;
+      for (const auto& bandConv : bandConvs)
+        found |= bandConv.H == y1 - y0 && bandConv.padTop == padTop && bandConv.padBottom == padBottom;
+      if (found)
+        continue;
+
+      const int srcBandH = (y1 - y0) + 2 - padTop - padBottom;
+      const dnnl::memory::desc srcBandDesc =
+        TensorDesc({1, C, srcBandH, W}, src->layout, src->dataType, src->scale);
+      const dnnl::memory::desc dstBandDesc =
+        TensorDesc({1, OC, y1 - y0, W}, dst->layout, dst->dataType, dst->scale);
+
+      auto primDesc = getConvPrimDesc(device, dnnl::algorithm::convolution_direct,
+                                      srcBandDesc, weights->dims, bias->dims, dstBandDesc,
+                                      {padTop, 1}, {padBottom, 1}, true, outputScales);
+
+      BandConv bandConv;
+      bandConv.H = y1 - y0;
+      bandConv.padTop = padTop;
+      bandConv.padBottom = padBottom;
+      bandConv.prim = dnnl::convolution_forward(primDesc);
+
+      // Share the reordered weights and bias between the bands if possible
+      bandConv.weights = getWeights(device, weightsKey, name + ".weight",
+                                    bandConvs.empty() ? weights : bandConvs[0].weights,
+                                    primDesc.weights_desc());
+      bandConv.bias = getWeights(device, weightsKey, name + ".bias",
+                                 bandConvs.empty() ? bias : bandConvs[0].bias,
+                                 primDesc.bias_desc());
+
+      bandConv.src = dnnl::memory(primDesc.src_desc(), device->getDNNLEngine(), nullptr);
+      bandConv.dst = dnnl::memory(primDesc.dst_desc(), device->getDNNLEngine(), nullptr);
+
+      scratchpadSize  = max(scratchpadSize, primDesc.scratchpad_desc().get_size());
+      srcBandByteSize = max(srcBandByteSize, primDesc.src_desc().get_size());
+      dstBandByteSize = max(dstBandByteSize, primDesc.dst_desc().get_size());
+
+      if (device->isVerbose(3))
+      {
+        std::cout << "Convolution " << name << " (band " << bandConv.H << "x" << W << "): "
+                  << getImplInfo(primDesc) << std::endl;
+      }
+
+      bandConvs.push_back(std::move(bandConv));
+    }
+
+    // Sources with a single channel block are convolved in place
+    if (C == getBlockC(*src))
+      srcBandByteSize = 0;
+  }
+
+  size_t ConvPoolNode::getScratchSize() const
+  {
+    return round_up(scratchpadSize, memoryAlignment) +
+           round_up(srcBandByteSize, memoryAlignment) +
+           dstBandByteSize;
+  }
+
+  void ConvPoolNode::setScratch(const std::shared_ptr<Tensor>& scratch)
+  {
+    this->scratch = scratch;
+    char* ptr = (char*)scratch->data();
+
+    if (scratchpadSize > 0)
+    {
+      dnnl::memory::desc scratchpadDesc({int64_t(scratchpadSize)}, dnnl::memory::data_type::u8,
+                                        dnnl::memory::format_tag::x);
+      scratchpad = dnnl::memory(scratchpadDesc, device->getDNNLEngine(), ptr);
+    }
+    ptr += round_up(scratchpadSize, memoryAlignment);
+
+    srcBand = ptr;
+    ptr += round_up(srcBandByteSize, memoryAlignment);
+
+    dstBand = ptr;
+    for (auto& bandConv : bandConvs)
+      bandConv.dst.set_data_handle(dstBand);
+  }
+
+  ConvPoolNode::BandConv& ConvPoolNode::getBandConv(int y0, int y1)
+  {
+    const int padTop    = (y0 == 0) ? 1 : 0;
+    const int padBottom = (y1 == H) ? 1 : 0;
+
+    for (auto& bandConv : bandConvs)
+    {
+      if (bandConv.H == y1 - y0 && bandConv.padTop == padTop && bandConv.padBottom == padBottom)
+        return bandConv;
+    }
+
+    throw Exception(Error::Unknown, "missing convolution band");
+  }
+
+  template<typename T, typename F>
+  void ConvPoolNode::pool(int n, int y0, int y1, F max)
+  {
+    const int B = dstBlockC;
+    const int numBlocks = OC / B;
+    const int bandH = y1 - y0;
+    const T* bandPtr = (const T*)dstBand;
+    T* dstPtr = (T*)dst->data() + size_t(n) * numBlocks * (H/2) * (W/2) * B;
+
+    parallel_nd(numBlocks, bandH / 2, [&](int cb, int y)
+    {
+      const T* src0 = bandPtr + (size_t(cb) * bandH + 2*y) * W * B;
+      const T* src1 = src0 + W * B;
+      T* dstRow = dstPtr + (size_t(cb) * (H/2) + y0/2 + y) * (W/2) * B;
+
+      for (int x = 0; x < W/2; ++x)
+      {
+        for (int b = 0; b < B; ++b)
+        {
+          dstRow[x*B + b] = max(max(src0[(2*x)*B + b], src0[(2*x+1)*B + b]),
+                                max(src1[(2*x)*B + b], src1[(2*x+1)*B + b]));
+        }
+      }
+    });
+  }
+
+  void ConvPoolNode::execute()
+  {
+    const int N = src->batchSize();
+
+    for (int n = 0; n < N; ++n)
+    {
+      for (int y0 = 0; y0 < H; y0 += bandH)
+      {
+        const int y1 = min(y0 + bandH, H);
+        BandConv& bandConv = getBandConv(y0, y1);
+
+        // Get the source rows of the band (including the rows above and below)
+        bandConv.src.set_data_handle(getRows(*src, n, max(y0 - 1, 0), min(y1 + 1, H), srcBand));
+
+        std::unordered_map<int, dnnl::memory> args = {
+          {DNNL_ARG_SRC,     bandConv.src},
+          {DNNL_ARG_WEIGHTS, bandConv.weights->mem},
+          {DNNL_ARG_BIAS,    bandConv.bias->mem},
+          {DNNL_ARG_DST,     bandConv.dst}};
+        if (scratchpadSize > 0)
+          args.emplace(DNNL_ARG_SCRATCHPAD, scratchpad);
+        bandConv.prim.execute(device->getDNNLStream(), args);
+
+        // Pool the band
+        switch (dst->dataType)
+        {
+        case DataType::Float32:
+          pool<float>(n, y0, y1, [](float a, float b) { return max(a, b); });
+          break;
+        case DataType::BFloat16:
+          // Compare the values as floats but copy the original bits
+          pool<uint16_t>(n, y0, y1, [](uint16_t a, uint16_t b)
+          {
+            const uint32_t ai = uint32_t(a) << 16, bi = uint32_t(b) << 16;
+            float af, bf;
+            memcpy(&af, &ai, sizeof(float));
+            memcpy(&bf, &bi, sizeof(float));
+            return (bf > af) ? b : a;
+          });
+          break;
+        case DataType::UInt8:
+          pool<uint8_t>(n, y0, y1, [](uint8_t a, uint8_t b) { return max(a, b); });
+          break;
+        default:
+          throw Exception(Error::Unknown, "unsupported data type for pooling");
+        }
+      }
+    }
+  }
+
+  UpsampleConvNode::UpsampleConvNode(const Ref<Device>& device,
+                                     const std::string& name,
+                                     const std::shared_ptr<Tensor>& src,
+                                     const std::shared_ptr<Tensor>& skip,
+                                     const std::shared_ptr<Tensor>& weights,
+                                     const std::shared_ptr<Tensor>& bias,
+                                     const std::shared_ptr<Tensor>& dst,
+                                     const std::string& weightsKey)
+    : Node(device, name),
+      src(src), skip(skip), dst(dst)
+  {
+    const int C1 = src->numChannels();
+    const int C2 = skip->numChannels();
+    H  = dst->height();
+    W  = dst->width();
+    OC = dst->numChannels();
+    const int srcH = src->height();
+    const int srcW = src->width();
+    assert(skip->height() == H && skip->width() == W);
+    assert(srcH * 2 == H && srcW * 2 == W);
+    assert(weights->dataType == DataType::Float32);
+    assert(weights->dims == TensorDims({OC, C1 + C2, 3, 3}));
+
+    // Split the weights into the weights of the skip and phase convolutions, if they are
+    // not in the weights cache already
+    // Each tap of a phase kernel is the sum of the 3x3 taps which read the same source pixel
+    const TensorDims skipWeightsDims  = {OC, C2, 3, 3};
+    const TensorDims phaseWeightsDims = {OC, C1, 2, 2};
+    std::shared_ptr<Tensor> skipWeights;
+    std::shared_ptr<Tensor> phaseWeights[2][2];
+
+    auto splitWeights = [&]()
+    {
+      if (skipWeights)
+        return;
+
+      static const int phaseTaps[2][2][3] = {{{1, 0, 0}, {0, 1, 1}},  // even rows/columns
+                                             {{1, 1, 0}, {0, 0, 1}}}; // odd rows/columns
+
+      skipWeights = std::make_shared<Tensor>(device, skipWeightsDims, TensorLayout::oihw, DataType::Float32);
+      for (int a = 0; a < 2; ++a)
+        for (int b = 0; b < 2; ++b)
+          phaseWeights[a][b] = std::make_shared<Tensor>(device, phaseWeightsDims, TensorLayout::oihw, DataType::Float32);
+
+      for (int o = 0; o < OC; ++o)
+      {
+        for (int i = 0; i < C2; ++i)
+          for (int ky = 0; ky < 3; ++ky)
+            for (int kx = 0; kx < 3; ++kx)
+              skipWeights->get<float>(o, i, ky, kx) = weights->get<float>(o, C1 + i, ky, kx);
+
+        for (int i = 0; i < C1; ++i)
+        {
+          for (int a = 0; a < 2; ++a)
+          {
+            for (int b = 0; b < 2; ++b)
+            {
+              for (int r = 0; r < 2; ++r)
+              {
+                for (int c = 0; c < 2; ++c)
+                {
+                  float value = 0.f;
+                  for (int ky = 0; ky < 3; ++ky)
+                    for (int kx = 0; kx < 3; ++kx)
+                      if (phaseTaps[a][r][ky] && phaseTaps[b][c][kx])
+                        value += weights->get<float>(o, i, ky, kx);
+                  phaseWeights[a][b]->get<float>(o, i, r, c) = value;
+                }
+              }
+            }
+          }
+        }
+      }
+    };
+
+    bandH = min(getBandH(size_t(OC) * W * 2 * sizeof(float)), srcH);
+
+    // Create the convolutions for all band shapes, which differ only in the first and last bands
+    for (int y0 = 0; y0 < srcH; y0 += bandH)
+    {
+      const int y1 = min(y0 + bandH, srcH);
+      const bool first = (y0 == 0);
+      const bool last  = (y1 == srcH);
+
+      bool found = false;
+      for (const auto& bandConv : bandConvs)
+        found |= bandConv.H == y1 - y0 && bandConv.first == first && bandConv.last == last;
+      if (found)
+        continue;
+
+      BandConv bandConv;
+      bandConv.H = y1 - y0;
+      bandConv.first = first;
+      bandConv.last = last;
+
+      // Skip convolution, which also adds the bias
+      const int skipBandH = 2 * (y1 - y0) + 2 - first - last;
+      const dnnl::memory::desc skipSrcDesc =
+        TensorDesc({1, C2, skipBandH, W}, skip->layout, skip->dataType);
+      const dnnl::memory::desc skipDstDesc =
+        TensorDesc({1, OC, 2 * (y1 - y0), W}, dst->layout, DataType::Float32);
+
+      auto skipPrimDesc = getConvPrimDesc(device, dnnl::algorithm::convolution_direct,
+                                          skipSrcDesc, skipWeightsDims, bias->dims, skipDstDesc,
+                                          {int(first), 1}, {int(last), 1}, false, {});
+
+      bandConv.skipPrim = dnnl::convolution_forward(skipPrimDesc);
+      bandConv.skipWeights = getWeights(device, weightsKey, name + ".skip.weight", [&]()
+      {
+        if (!bandConvs.empty())
+          return bandConvs[0].skipWeights;
+        splitWeights();
+        return skipWeights;
+      }, skipPrimDesc.weights_desc());
+
+      bandConv.bias = getWeights(device, weightsKey, name + ".bias",
+                                 bandConvs.empty() ? bias : bandConvs[0].bias,
+                                 skipPrimDesc.bias_desc());
+      bandConv.skipSrc = dnnl::memory(skipSrcDesc, device->getDNNLEngine(), nullptr);
+      bandConv.skipDst = dnnl::memory(skipDstDesc, device->getDNNLEngine(), nullptr);
+
+      scratchpadSize = max(scratchpadSize, skipPrimDesc.scratchpad_desc().get_size());
+      skipBandByteSize = max(skipBandByteSize, skipSrcDesc.get_size());
+      skipDstBandByteSize = max(skipDstBandByteSize, skipDstDesc.get_size());
+
+      // Phase convolutions
+      for (int a = 0; a < 2; ++a)
+      {
+        // Even rows read the source rows above, odd rows the source rows below
+        const int padTop    = (a == 0) && first;
+        const int padBottom = (a == 1) && last;
+        const dnnl::memory::desc phaseSrcDesc =
+          TensorDesc({1, C1, (y1 - y0) + 1 - padTop - padBottom, srcW}, src->layout, src->dataType);
+        const dnnl::memory::desc phaseDstDesc =
+          TensorDesc({1, OC, y1 - y0, srcW}, dst->layout, DataType::Float32);
+
+        bandConv.phaseSrc[a] = dnnl::memory(phaseSrcDesc, device->getDNNLEngine(), nullptr);
+        phaseBandByteSize = max(phaseBandByteSize, phaseSrcDesc.get_size());
+        phaseDstBandByteSize = max(phaseDstBandByteSize, phaseDstDesc.get_size());
+
+        for (int b = 0; b < 2; ++b)
+        {
+          auto phasePrimDesc = getConvPrimDesc(device, dnnl::algorithm::convolution_direct,
+                                               phaseSrcDesc, phaseWeightsDims, {}, phaseDstDesc,
+                                               {padTop, 1 - b}, {padBottom, b}, false, {});
+
+          bandConv.phasePrims[a][b] = dnnl::convolution_forward(phasePrimDesc);
+          const std::string phaseName = name + ".phase" + std::to_string(a) + std::to_string(b) + ".weight";
+          bandConv.phaseWeights[a][b] = getWeights(device, weightsKey, phaseName, [&]()
+          {
+            if (!bandConvs.empty())
+              return bandConvs[0].phaseWeights[a][b];
+            splitWeights();
+            return phaseWeights[a][b];
+          }, phasePrimDesc.weights_desc());
+          bandConv.phaseDst[a][b] = dnnl::memory(phaseDstDesc, device->getDNNLEngine(), nullptr);
+
+          scratchpadSize = max(scratchpadSize, phasePrimDesc.scratchpad_desc().get_size());
+
+          if (device->isVerbose(3) && bandConvs.empty() && a == 0 && b == 0)
+          {
+            std::cout << "Convolution " << name << ": " << getImplInfo(skipPrimDesc)
+                      << " (skip), " << getImplInfo(phasePrimDesc) << " (upsampled)" << std::endl;
+          }
+        }
+      }
+
+      bandConvs.push_back(std::move(bandConv));
+    }
+
+    // Sources with a single channel block are convolved in place
+    if (C2 == getBlockC(*skip))
+      skipBandByteSize = 0;
+    if (C1 == getBlockC(*src))
+      phaseBandByteSize = 0;
+  }
+
+  size_t UpsampleConvNode::getScratchSize() const
+  {
+    return round_up(scratchpadSize, memoryAlignment) +
+           round_up(skipBandByteSize, memoryAlignment) +
+           round_up(phaseBandByteSize, memoryAlignment) * 2 +
+           round_up(skipDstBandByteSize, memoryAlignment) +
+           round_up(phaseDstBandByteSize, memoryAlignment) * 4;
+  }
+
+  void UpsampleConvNode::setScratch(const std::shared_ptr<Tensor>& scratch)
+  {
+    this->scratch = scratch;
+    char* ptr = (char*)scratch->data();
+
+    if (scratchpadSize > 0)
+    {
+      dnnl::memory::desc scratchpadDesc({int64_t(scratchpadSize)}, dnnl::memory::data_type::u8,
+                                        dnnl::memory::format_tag::x);
+      scratchpad = dnnl::memory(scratchpadDesc, device->getDNNLEngine(), ptr);
+    }
+    ptr += round_up(scratchpadSize, memoryAlignment);
+
+    skipBand = ptr;
+    ptr += round_up(skipBandByteSize, memoryAlignment);
+
+    for (int a = 0; a < 2; ++a)
+    {
+      phaseBands[a] = ptr;
+      ptr += round_up(phaseBandByteSize, memoryAlignment);
+    }
+
+    skipDstBand = (float*)ptr;
+    ptr += round_up(skipDstBandByteSize, memoryAlignment);
+
+    for (int a = 0; a < 2; ++a)
+    {
+      for (int b = 0; b < 2; ++b)
+      {
+        phaseDstBands[a][b] = (float*)ptr;
+        ptr += round_up(phaseDstBandByteSize, memoryAlignment);
+      }
+    }
+
+    for (auto& bandConv : bandConvs)
+    {
+      bandConv.skipDst.set_data_handle(skipDstBand);
+      for (int a = 0; a < 2; ++a)
+        for (int b = 0; b < 2; ++b)
+          bandConv.phaseDst[a][b].set_data_handle(phaseDstBands[a][b]);
+    }
+  }
+
+  UpsampleConvNode::BandConv& UpsampleConvNode::getBandConv(int y0, int y1)
+  {
+    const bool first = (y0 == 0);
+    const bool last  = (y1 == src->height());
+
+    for (auto& bandConv : bandConvs)
+    {
+      if (bandConv.H == y1 - y0 && bandConv.first == first && bandConv.last == last)
+        return bandConv;
+    }
+
+    throw Exception(Error::Unknown, "missing convolution band");
+  }
+
+  // Sums the partial results of a band of source rows into the destination
+  template<typename T, typename F>
+  void UpsampleConvNode::sum(int n, int y0, int y1, F convert)
+  {
+    const int B = getBlockC(*dst);
+    const int numBlocks = OC / B;
+    const int bandH = y1 - y0;
+    const int srcW = W / 2;
+    T* dstPtr = (T*)dst->data() + size_t(n) * numBlocks * H * W * B;
+
+    parallel_nd(numBlocks, bandH * 2, [&](int cb, int y)
+    {
+      const float* skipRow = skipDstBand + (size_t(cb) * bandH * 2 + y) * W * B;
+      const float* phaseRow0 = phaseDstBands[y % 2][0] + (size_t(cb) * bandH + y / 2) * srcW * B;
+      const float* phaseRow1 = phaseDstBands[y % 2][1] + (size_t(cb) * bandH + y / 2) * srcW * B;
+      T* dstRow = dstPtr + (size_t(cb) * H + y0 * 2 + y) * W * B;
+
+      for (int x = 0; x < srcW; ++x)
+      {
+        for (int b = 0; b < B; ++b)
+        {
+          dstRow[(2*x)  *B + b] = convert(max(skipRow[(2*x)  *B + b] + phaseRow0[x*B + b], 0.f));
+          dstRow[(2*x+1)*B + b] = convert(max(skipRow[(2*x+1)*B + b] + phaseRow1[x*B + b], 0.f));
+        }
+      }
+    });
+  }
+
+  void UpsampleConvNode::execute()
+  {
+    const int N = dst->batchSize();
+    const int srcH = src->height();
+
+    auto executePrim = [&](dnnl::primitive& prim, std::unordered_map<int, dnnl::memory> args)
+    {
+      if (scratchpadSize > 0)
+        args.emplace(DNNL_ARG_SCRATCHPAD, scratchpad);
+      prim.execute(device->getDNNLStream(), args);
+    };
+
+    for (int n = 0; n < N; ++n)
+    {
+      for (int y0 = 0; y0 < srcH; y0 += bandH)
+      {
+        const int y1 = min(y0 + bandH, srcH);
+        BandConv& bandConv = getBandConv(y0, y1);
+
+        // Convolve the skip rows of the band (including the rows above and below)
+        bandConv.skipSrc.set_data_handle(getRows(*skip, n, max(y0*2 - 1, 0), min(y1*2 + 1, H), skipBand));
+        executePrim(bandConv.skipPrim,
+          {{DNNL_ARG_SRC,     bandConv.skipSrc},
+           {DNNL_ARG_WEIGHTS, bandConv.skipWeights->mem},
+           {DNNL_ARG_BIAS,    bandConv.bias->mem},
+           {DNNL_ARG_DST,     bandConv.skipDst}});
+
+        // Convolve the source rows of the band for each phase
+        for (int a = 0; a < 2; ++a)
+        {
+          bandConv.phaseSrc[a].set_data_handle(getRows(*src, n, max(y0 - 1 + a, 0), min(y1 + a, srcH), phaseBands[a]));
+          for (int b = 0; b < 2; ++b)
+          {
+            executePrim(bandConv.phasePrims[a][b],
+              {{DNNL_ARG_SRC,     bandConv.phaseSrc[a]},
+               {DNNL_ARG_WEIGHTS, bandConv.phaseWeights[a][b]->mem},
+               {DNNL_ARG_DST,     bandConv.phaseDst[a][b]}});
+          }
+        }
+
+        switch (dst->dataType)
+        {
+        case DataType::Float32:
+          sum<float>(n, y0, y1, [](float x) { return x; });
+          break;
+        case DataType::BFloat16:
+          sum<uint16_t>(n, y0, y1, toBF16);
+          break;
+        default:
+          throw Exception(Error::Unknown, "unsupported data type for upsampling convolution");
+        }
+      }
+    }
+  }
+
+#endif
+
+} // namespace oidn
@@ -10,6 +10,10 @@ namespace oidn {
 #if defined(OIDN_DNNL)
 
   // DNNL 3x3 convolution node
+  // Quantized (u8 source, s8 weights) convolutions also take per-output-channel
+  // scales, which are applied to the s32 accumulators after adding the bias
+  // The convolution algorithm is selected by the policy of the device
+  // The reordered weights are shared by the filters of the device if a weights key is specified
   class ConvNode : public DNNLNode
   {
   private:
@@ -17,6 +21,7 @@ namespace oidn {
     std::shared_ptr<Tensor> weights;
     std::shared_ptr<Tensor> bias;
     std::shared_ptr<Tensor> dst;
+    bool relu;
 
   public:
     ConvNode(const Ref<Device>& device,
@@ -25,72 +30,150 @@ namespace oidn {
              const std::shared_ptr<Tensor>& weights,
              const std::shared_ptr<Tensor>& bias,
              const std::shared_ptr<Tensor>& dst,
-             bool relu)
-      : DNNLNode(device, name),
-        src(src), weights(weights), bias(bias), dst(dst)
+             bool relu,
+             const std::vector<float>& outputScales = {},
+             const std::string& weightsKey = "");
+
+    std::shared_ptr<Tensor> getDst() const override { return dst; }
+    double getFlopCount() const override { return 2. * dst->numElements() * src->numChannels() * 9; }
+
+  private:
+    bool isWinogradFaster(const dnnl::convolution_forward::primitive_desc& directPrimDesc,
+                          const dnnl::convolution_forward::primitive_desc& winogradPrimDesc);
+    double benchmark(const dnnl::convolution_forward::primitive_desc& primDesc);
+  };
+
+  // DNNL 3x3 convolution with relu fused with the following 2x2 max pooling
+  // The convolution is computed in bands of rows, which are pooled while still in the cache,
+  // so the full-resolution output is never stored. The bands are kept in the node scratch.
+  class ConvPoolNode : public Node
+  {
+  private:
+    // Convolution of a band of rows with a given vertical padding
+    struct BandConv
     {
-      const dnnl::memory::dims strides = {1, 1};
-      const dnnl::memory::dims padding = {1, 1};
-
-      // Let the convolution primitive choose the weights format
-      auto weightsDesc = dnnl::memory::desc({ weights->dims },
-                                            src->mem.get_desc().data_type(),
-                                            dnnl::memory::format_tag::any);
-
-      // Let the convolution primitive choose the bias format
-      auto biasDesc = dnnl::memory::desc({ bias->dims },
-                                         src->mem.get_desc().data_type(),
-                                         dnnl::memory::format_tag::any);
-
-      auto convDesc = dnnl::convolution_forward::desc(
-        dnnl::prop_kind::forward_inference, dnnl::algorithm::convolution_direct,
-        src->mem.get_desc(),
-        weightsDesc,
-        biasDesc,
-        dst->mem.get_desc(),
-        strides, padding, padding);
-
-      // Incorporate relu
-      dnnl::primitive_attr convAttr;
-      if (relu)
-      {
-        dnnl::post_ops ops;
-        ops.append_eltwise(
-          1.f,   // scale
-          dnnl::algorithm::eltwise_relu,
-          0.f,   // alpha
-          0.f    // beta
-        );
-        convAttr.set_post_ops(ops);
-      }
-      convAttr.set_scratchpad_mode(dnnl::scratchpad_mode::user);
-
-      auto convPrimDesc = dnnl::convolution_forward::primitive_desc(convDesc, convAttr, device->getDNNLEngine());
-
-      // Reorder the weights to the final format, if necessary
-      if (convPrimDesc.weights_desc() != weights->mem.get_desc())
-      {
-        this->weights = std::make_shared<Tensor>(device, convPrimDesc.weights_desc());
-        ReorderNode(device, "weightsReorder", weights, this->weights).execute();
-        device->wait();
-      }
-
-      // Reorder the bias to the final format, if necessary
-      if (convPrimDesc.bias_desc() != bias->mem.get_desc())
-      {
-        this->bias = std::make_shared<Tensor>(device, convPrimDesc.bias_desc());
-        ReorderNode(device, "biasReorder", bias, this->bias).execute();
-        device->wait();
-      }
-
-      prim = dnnl::convolution_forward(convPrimDesc);
-      args = {{DNNL_ARG_SRC,     src->mem},
-              {DNNL_ARG_WEIGHTS, this->weights->mem},
-              {DNNL_ARG_BIAS,    this->bias->mem},
-              {DNNL_ARG_DST,     dst->mem}};
-    }
+      int H;       // number of output rows
+      int padTop;
+      int padBottom;
+      dnnl::convolution_forward prim;
+      std::shared_ptr<Tensor> weights;
+      std::shared_ptr<Tensor> bias;
+      dnnl::memory src;
+      dnnl::memory dst;
+    };
+
+    std::shared_ptr<Tensor> src;
+    std::shared_ptr<Tensor> dst;
+    int C, H, W;        // source (and unpooled destination) size
+    int OC;
+    int bandH;          // number of output rows per band
+    int dstBlockC;      // channels per block in the destination layout
+    std::vector<BandConv> bandConvs;
+    size_t scratchpadSize = 0;
+    size_t srcBandByteSize = 0;
+    size_t dstBandByteSize = 0;
+    std::shared_ptr<Tensor> scratch;
+    dnnl::memory scratchpad;
+    char* srcBand = nullptr;
+    char* dstBand = nullptr;
+
+  public:
+    ConvPoolNode(const Ref<Device>& device,
+                 const std::string& name,
+                 const std::shared_ptr<Tensor>& src,
+                 const std::shared_ptr<Tensor>& weights,
+                 const std::shared_ptr<Tensor>& bias,
+                 const std::shared_ptr<Tensor>& dst,
+                 const std::vector<float>& outputScales = {},
+                 const std::string& weightsKey = "");
+
+    void execute() override;
 
     std::shared_ptr<Tensor> getDst() const override { return dst; }
+    double getFlopCount() const override { return 2. * src->batchSize() * OC * H * W * C * 9; }
+
+    size_t getScratchSize() const override;
+    void setScratch(const std::shared_ptr<Tensor>& scratch) override;
+
+  private:
+    BandConv& getBandConv(int y0, int y1);
+    template<typename T, typename F>
+    void pool(int n, int y0, int y1, F max);
+  };
+
+  // DNNL 3x3 convolution with relu of the concatenation of a 2x nearest-neighbor
+  // upsampled source and a skip tensor, without storing the upsampled tensor
+  // The upsampled part is computed as four 2x2 convolutions of the source, one for each
+  // phase of the output pixels, and the skip part as a 3x3 convolution of the skip tensor.
+  // The partial results are computed in bands of rows in the node scratch and summed
+  // into the destination.
+  class UpsampleConvNode : public Node
+  {
+  private:
+    // Convolutions of a band of source rows
+    struct BandConv
+    {
+      int H;       // number of source rows
+      bool first;  // first band (padded at the top)
+      bool last;   // last band (padded at the bottom)
+
+      dnnl::convolution_forward skipPrim;
+      std::shared_ptr<Tensor> skipWeights;
+      std::shared_ptr<Tensor> bias;
+      dnnl::memory skipSrc;
+      dnnl::memory skipDst;
+
+      // Indexed by the vertical and horizontal phase of the output pixels
+      dnnl::convolution_forward phasePrims[2][2];
+      std::shared_ptr<Tensor> phaseWeights[2][2];
+      dnnl::memory phaseSrc[2];
+      dnnl::memory phaseDst[2][2];
+    };
+
+    std::shared_ptr<Tensor> src;
+    std::shared_ptr<Tensor> skip;
+    std::shared_ptr<Tensor> dst;
+    int H, W;           // destination size
+    int OC;
+    int bandH;          // number of source rows per band
+    std::vector<BandConv> bandConvs;
+    size_t scratchpadSize = 0;
+    size_t skipBandByteSize = 0;
+    size_t phaseBandByteSize = 0;
+    size_t skipDstBandByteSize = 0;
+    size_t phaseDstBandByteSize = 0;
+    std::shared_ptr<Tensor> scratch;
+    dnnl::memory scratchpad;
+    char* skipBand = nullptr;
+    char* phaseBands[2] = {};
+    float* skipDstBand = nullptr;
+    float* phaseDstBands[2][2] = {};
+
+  public:
+    UpsampleConvNode(const Ref<Device>& device,
+                     const std::string& name,
+                     const std::shared_ptr<Tensor>& src,
+                     const std::shared_ptr<Tensor>& skip,
+                     const std::shared_ptr<Tensor>& weights,
+                     const std::shared_ptr<Tensor>& bias,
+                     const std::shared_ptr<Tensor>& dst,
+                     const std::string& weightsKey = "");
+
+    void execute() override;
+
+    std::shared_ptr<Tensor> getDst() const override { return dst; }
+    double getFlopCount() const override
+    {
+      return 2. * dst->batchSize() * OC * H * W * (skip->numChannels() * 9 + src->numChannels() * 4);
+    }
+
+    size_t getScratchSize() const override;
+    void setScratch(const std::shared_ptr<Tensor>& scratch) override;
+
+  private:
+    BandConv& getBandConv(int y0, int y1);
+    template<typename T, typename F>
+    void sum(int n, int y0, int y1, F convert);
   };
 
 #elif defined(OIDN_BNNS)
@@ -144,6 +227,7 @@ namespace oidn {
     }
 
     std::shared_ptr<Tensor> getDst() const override { return dst; }
+    double getFlopCount() const override { return 2. * dst->numElements() * src->numChannels() * 9; }
   };
 
 #endif
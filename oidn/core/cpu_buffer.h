@@ -3,7 +3,8 @@
 
 #pragma once
 
-#include "buffer.h"
+#include "device.h"
+#include "memory_pool.h"
 
 namespace oidn {
 
@@ -15,13 +16,17 @@ namespace oidn {
     size_t byteSize;
     bool shared;
     Ref<Device> device;
+    MemoryBlock block; // pooled memory of the buffer, if any
 
   public:
     CPUBuffer(const Ref<Device>& device, size_t size)
-      : ptr(allocData(size)),
+      : ptr(nullptr),
         byteSize(size),
         shared(false),
-        device(device) {}
+        device(device)
+    {
+      ptr = allocData(size);
+    }
 
     CPUBuffer(const Ref<Device>& device, void* data, size_t size)
       : ptr((char*)data),
@@ -68,12 +73,40 @@ namespace oidn {
   private:
     char* allocData(size_t size)
     {
-      return (char*)alignedMalloc(size);
+      if (size < hugePageSize || !device->isHugePagesEnabled())
+        return (char*)alignedMalloc(size);
+
+      // The block is taken from the free list of the NUMA node of the calling thread. Inside the
+      // arena, that thread is pinned to a core of the device if thread affinity is enabled,
+      // otherwise it may be on any node. New pages are first touched in parallel to spread them
+      // over the nodes of the threads which will access them, instead of placing all on the node
+      // of the calling thread. Each huge page is touched by a single thread, as the whole page is
+      // placed on its node.
+      device->executeTask([&]()
+      {
+        bool isNew;
+        block = MemoryPool::get().alloc(size, isNew);
+        if (isNew)
+        {
+          parallel_nd(block.size / hugePageSize, [&](size_t i)
+          {
+            block.ptr[i * hugePageSize] = 0;
+          });
+        }
+      });
+
+      return block.ptr;
     }
 
     void freeData(void* ptr)
     {
-      alignedFree(ptr);
+      if (block.ptr)
+      {
+        MemoryPool::get().free(block);
+        block = MemoryBlock();
+      }
+      else
+        alignedFree(ptr);
     }
   };
 
@@ -15,9 +15,31 @@ namespace oidn {
   #if defined(OIDN_DNNL)
     dnnl_set_verbose(clamp(verbose - 2, 0, 2)); // unfortunately this is not per-device but global
     dnnlEngine = dnnl::engine(dnnl::engine::kind::cpu, 0);
-    dnnlStream = dnnl::stream(dnnlEngine);
     tensorBlockSize = isISASupported(ISA::AVX512_CORE) ? 16 : 8;
+
+    // Use bf16 tensors only with native bf16 instructions, the emulation would be slower than f32
+    if (bf16)
+    {
+      if (isISASupported(ISA::AVX512_CORE_BF16))
+        tensorDataType = DataType::BFloat16;
+      else
+        warning("bf16 is not supported by the CPU, falling back to f32");
+    }
+
+    // Without VNNI the int8 convolutions could saturate the 16-bit intermediate sums
+    if (int8 && !isISASupported(ISA::AVX512_CORE_VNNI))
+    {
+      warning("int8 is not supported by the CPU, falling back to floating-point");
+      int8 = false;
+    }
   #else
+    if (bf16)
+      warning("bf16 is not supported by the neural network runtime, falling back to f32");
+    if (int8)
+    {
+      warning("int8 is not supported by the neural network runtime, falling back to floating-point");
+      int8 = false;
+    }
     tensorBlockSize = 1;
   #endif
   }
@@ -26,7 +48,11 @@ namespace oidn {
   {
     std::cout << "  ISA     : ";
   #if defined(OIDN_X64)
-    if (isISASupported(ISA::AVX512_CORE))
+    if (isISASupported(ISA::AVX512_CORE_BF16))
+      std::cout << "AVX512_BF16";
+    else if (isISASupported(ISA::AVX512_CORE_VNNI))
+      std::cout << "AVX512_VNNI";
+    else if (isISASupported(ISA::AVX512_CORE))
       std::cout << "AVX512";
     else if (isISASupported(ISA::AVX2))
       std::cout << "AVX2";
@@ -42,6 +68,10 @@ namespace oidn {
     std::cout << "DNNL (oneDNN) " << DNNL_VERSION_MAJOR << "." <<
                                      DNNL_VERSION_MINOR << "." <<
                                      DNNL_VERSION_PATCH;
+    if (tensorDataType == DataType::BFloat16)
+      std::cout << " (bf16)";
+    if (int8)
+      std::cout << " (int8)";
   #elif defined(OIDN_BNNS)
     std::cout << "BNNS";
   #endif
@@ -2,12 +2,14 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "device.h"
+#include "memory_pool.h"
 #include "scratch.h"
 #include "unet.h"
 
 namespace oidn {
 
   thread_local Device::ErrorState Device::globalError;
+  thread_local Device* Device::asyncTaskDevice = nullptr;
 
   Device::Device()
   {
@@ -21,11 +23,23 @@ namespace oidn {
       error.verbose = verbose;
     getEnvVar("OIDN_NUM_THREADS", numThreads);
     getEnvVar("OIDN_SET_AFFINITY", setAffinity);
+    getEnvVar("OIDN_BF16", bf16);
+    getEnvVar("OIDN_INT8", int8);
+    int convAlgoValue;
+    if (getEnvVar("OIDN_CONV_ALGO", convAlgoValue))
+      convAlgo = toConvAlgo(convAlgoValue);
+    getEnvVar("OIDN_CONCURRENT_FILTERS", concurrentFilters);
+    getEnvVar("OIDN_HUGE_PAGES", hugePages);
+
+    MemoryPool::get().addDevice();
   }
 
   Device::~Device()
   {
     observer.reset();
+
+    // All buffers of the device have been freed at this point
+    MemoryPool::get().removeDevice();
   }
 
   void Device::setError(Device* device, Error code, const std::string& message)
@@ -110,6 +124,16 @@ namespace oidn {
       return setAffinity;
     else if (name == "verbose")
       return verbose;
+    else if (name == "bf16")
+      return bf16;
+    else if (name == "int8")
+      return int8;
+    else if (name == "convAlgo")
+      return int(convAlgo);
+    else if (name == "concurrentFilters")
+      return concurrentFilters;
+    else if (name == "hugePages")
+      return hugePages;
     else if (name == "version")
       return OIDN_VERSION;
     else if (name == "versionMajor")
@@ -148,6 +172,41 @@ namespace oidn {
       else if (verbose != value || error.verbose != value)
         warning("OIDN_VERBOSE environment variable overrides device parameter");
     }
+    else if (name == "bf16")
+    {
+      if (!isEnvVar("OIDN_BF16"))
+        bf16 = value;
+      else if (bf16 != bool(value))
+        warning("OIDN_BF16 environment variable overrides device parameter");
+    }
+    else if (name == "int8")
+    {
+      if (!isEnvVar("OIDN_INT8"))
+        int8 = value;
+      else if (int8 != bool(value))
+        warning("OIDN_INT8 environment variable overrides device parameter");
+    }
+    else if (name == "convAlgo")
+    {
+      if (!isEnvVar("OIDN_CONV_ALGO"))
+        convAlgo = toConvAlgo(value);
+      else if (convAlgo != toConvAlgo(value))
+        warning("OIDN_CONV_ALGO environment variable overrides device parameter");
+    }
+    else if (name == "concurrentFilters")
+    {
+      if (!isEnvVar("OIDN_CONCURRENT_FILTERS"))
+        concurrentFilters = value;
+      else if (concurrentFilters != bool(value))
+        warning("OIDN_CONCURRENT_FILTERS environment variable overrides device parameter");
+    }
+    else if (name == "hugePages")
+    {
+      if (!isEnvVar("OIDN_HUGE_PAGES"))
+        hugePages = value;
+      else if (hugePages != bool(value))
+        warning("OIDN_HUGE_PAGES environment variable overrides device parameter");
+    }
     else
       warning("unknown device parameter");
 
@@ -211,14 +270,78 @@ namespace oidn {
     return filter;
   }
 
+  // Waits for the enqueued tasks of the device, except the one calling this function
+  void Device::waitAsyncTasks()
+  {
+    const int numSelf = (asyncTaskDevice == this) ? 1 : 0;
+    std::unique_lock<std::mutex> lock(asyncMutex);
+    asyncCond.wait(lock, [&]() { return numAsyncTasks <= numSelf; });
+  }
+
   Ref<ScratchBuffer> Device::newScratchBuffer(size_t byteSize)
   {
+    // Filters executing concurrently cannot share memory
+    if (concurrentFilters)
+      return makeRef<ScratchBuffer>(std::make_shared<ScratchBufferManager>(this), byteSize);
+
     auto scratchManager = scratchManagerWp.lock();
     if (!scratchManager)
       scratchManagerWp = scratchManager = std::make_shared<ScratchBufferManager>(this);
     return makeRef<ScratchBuffer>(scratchManager, byteSize);
   }
 
+  std::shared_ptr<Tensor> Device::getCachedWeights(const std::string& key,
+                                                   const std::function<std::shared_ptr<Tensor>()>& create)
+  {
+    {
+      std::lock_guard<std::mutex> lock(weightsCacheMutex);
+      auto it = weightsCache.find(key);
+      if (it != weightsCache.end())
+      {
+        if (auto weights = it->second.lock())
+          return weights;
+      }
+    }
+
+    // Create the weights without holding the lock, which may take a while
+    auto weights = create();
+
+    std::lock_guard<std::mutex> lock(weightsCacheMutex);
+
+    // Remove the weights which are no longer used
+    for (auto it = weightsCache.begin(); it != weightsCache.end(); )
+    {
+      if (it->second.expired())
+        it = weightsCache.erase(it);
+      else
+        ++it;
+    }
+
+    // The weights may have been created by another thread in the meantime
+    std::weak_ptr<Tensor>& cached = weightsCache[key];
+    if (auto cachedWeights = cached.lock())
+      return cachedWeights;
+    cached = weights;
+    return weights;
+  }
+
+#if defined(OIDN_DNNL)
+  dnnl::algorithm Device::getCachedConvAlgo(const std::string& key,
+                                            const std::function<dnnl::algorithm()>& benchmark)
+  {
+    // The lock is held while benchmarking, so concurrently committed filters do not benchmark
+    // the same shape twice or slow down each other's timing runs
+    std::lock_guard<std::mutex> lock(convAlgoCacheMutex);
+    auto it = convAlgoCache.find(key);
+    if (it != convAlgoCache.end())
+      return it->second;
+
+    const dnnl::algorithm algo = benchmark();
+    convAlgoCache.emplace(key, algo);
+    return algo;
+  }
+#endif
+
   void Device::initTasking()
   {
     // Get the thread affinities for one thread per core on non-hybrid CPUs with SMT
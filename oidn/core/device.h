@@ -5,6 +5,9 @@
 
 #include "common.h"
 #include "buffer.h"
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
 
 namespace oidn {
 
@@ -12,6 +15,22 @@ namespace oidn {
 
   class ScratchBuffer;
   class ScratchBufferManager;
+  class Tensor;
+
+  // Convolution algorithm policy
+  enum class ConvAlgo
+  {
+    Direct,   // direct convolution for all layers
+    Winograd, // Winograd convolution for the layers which support it
+    Auto,     // fastest algorithm for each layer (benchmarked once per device)
+  };
+
+  inline ConvAlgo toConvAlgo(int value)
+  {
+    if (value < int(ConvAlgo::Direct) || value > int(ConvAlgo::Auto))
+      throw Exception(Error::InvalidArgument, "invalid convolution algorithm");
+    return ConvAlgo(value);
+  }
 
   class Device : public RefCount, public Verbose
   {
@@ -36,14 +55,30 @@ namespace oidn {
     std::shared_ptr<PinningObserver> observer;
     std::shared_ptr<ThreadAffinity> affinity;
 
+    // Asynchronous tasks enqueued in the arena which have not finished yet
+    static thread_local Device* asyncTaskDevice; // device of the task run by the current thread
+    std::mutex asyncMutex;
+    std::condition_variable asyncCond;
+    int numAsyncTasks = 0;
+
     // Memory
     std::weak_ptr<ScratchBufferManager> scratchManagerWp;
 
+    // Weights in the final format shared by the filters (expired when no longer used)
+    std::mutex weightsCacheMutex;
+    std::unordered_map<std::string, std::weak_ptr<Tensor>> weightsCache;
+
+  #if defined(OIDN_DNNL)
+    // Fastest convolution algorithms of the shapes benchmarked so far (released with the device)
+    std::mutex convAlgoCacheMutex;
+    std::unordered_map<std::string, dnnl::algorithm> convAlgoCache;
+  #endif
+
   protected:
     // Neural network runtime
   #if defined(OIDN_DNNL)
     dnnl::engine dnnlEngine;
-    dnnl::stream dnnlStream;
+    ThreadLocal<dnnl::stream> dnnlStreams; // streams must not be used by multiple threads at once
   #endif
     DataType tensorDataType = DataType::Float32;
     int tensorBlockSize = 1;
@@ -51,6 +86,11 @@ namespace oidn {
     // Parameters
     int numThreads = 0; // autodetect by default
     bool setAffinity = true;
+    bool bf16 = false; // use bf16 tensors if supported by the hardware
+    bool int8 = false; // use int8 inference if supported by the hardware and the weights
+    ConvAlgo convAlgo = ConvAlgo::Direct;
+    bool concurrentFilters = false; // filters have private scratch memory and are locked individually
+    bool hugePages = true; // allocate large buffers from the pooled huge page memory
 
     bool dirty = true;
     bool committed = false;
@@ -70,11 +110,13 @@ namespace oidn {
 
     void commit();
 
+    // Runs the function in the arena. The calling thread does not pick up the enqueued tasks
+    // while it waits for its own ones, as they may wait for the mutex it holds.
     template<typename F>
     void executeTask(F& f)
     {
       if (arena)
-        arena->execute(f);
+        arena->execute([&]() { tbb::this_task_arena::isolate(f); });
       else
         f();
     }
@@ -83,15 +125,42 @@ namespace oidn {
     void executeTask(const F& f)
     {
       if (arena)
-        arena->execute(f);
+        arena->execute([&]() { tbb::this_task_arena::isolate(f); });
       else
         f();
     }
 
+    // Runs the function on a thread of the arena without waiting for it. The task keeps
+    // a reference to the device, and releasing the device waits for the pending tasks.
+    template<typename F>
+    void enqueueTask(const F& f)
+    {
+      {
+        std::lock_guard<std::mutex> lock(asyncMutex);
+        ++numAsyncTasks;
+      }
+
+      Ref<Device> self = this;
+      arena->enqueue([self, f]()
+      {
+        asyncTaskDevice = self.get();
+        f();
+        asyncTaskDevice = nullptr;
+
+        {
+          std::lock_guard<std::mutex> lock(self->asyncMutex);
+          --self->numAsyncTasks;
+        }
+        self->asyncCond.notify_all();
+      });
+    }
+
+    void waitAsyncTasks();
+
     void wait()
     {
     #if defined(OIDN_DNNL)
-      dnnlStream.wait();
+      getDNNLStream().wait();
     #endif
     }
 
@@ -100,6 +169,18 @@ namespace oidn {
 
     Ref<ScratchBuffer> newScratchBuffer(size_t byteSize);
 
+    // Returns the cached weights with the specified key if they are still used by a filter,
+    // otherwise creates them with the function and adds them to the cache
+    std::shared_ptr<Tensor> getCachedWeights(const std::string& key,
+                                             const std::function<std::shared_ptr<Tensor>()>& create);
+
+  #if defined(OIDN_DNNL)
+    // Returns the cached convolution algorithm with the specified key, otherwise benchmarks
+    // it with the function and adds it to the cache
+    dnnl::algorithm getCachedConvAlgo(const std::string& key,
+                                      const std::function<dnnl::algorithm()>& benchmark);
+  #endif
+
     Ref<Filter> newFilter(const std::string& type);
 
     __forceinline Device* getDevice() { return this; }
@@ -107,7 +188,16 @@ namespace oidn {
 
   #if defined(OIDN_DNNL)
     __forceinline dnnl::engine& getDNNLEngine() { return dnnlEngine; }
-    __forceinline dnnl::stream& getDNNLStream() { return dnnlStream; }
+
+    // Returns the stream of the calling thread, so concurrently executing filters and
+    // network instances do not share a stream
+    dnnl::stream& getDNNLStream()
+    {
+      dnnl::stream& stream = dnnlStreams.get();
+      if (!stream)
+        stream = dnnl::stream(dnnlEngine);
+      return stream;
+    }
   #endif
 
     // Returns the native tensor data type
@@ -116,6 +206,21 @@ namespace oidn {
     // Returns the native tensor layout block size
     __forceinline int getTensorBlockSize() const { return tensorBlockSize; }
 
+    // Returns the number of threads of the device
+    __forceinline int getNumThreads() const { return numThreads; }
+
+    // Returns whether int8 inference is enabled (used only with calibrated weights)
+    __forceinline bool isInt8Enabled() const { return int8; }
+
+    // Returns the convolution algorithm policy
+    __forceinline ConvAlgo getConvAlgo() const { return convAlgo; }
+
+    // Returns whether different filters of the device may execute concurrently
+    __forceinline bool hasConcurrentFilters() const { return concurrentFilters; }
+
+    // Returns whether large buffers are allocated from the huge page memory pool
+    __forceinline bool isHugePagesEnabled() const { return hugePages; }
+
     bool isCommitted() const { return committed; }
     void checkCommitted();
 
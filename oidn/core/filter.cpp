@@ -5,12 +5,132 @@
 
 namespace oidn {
 
+  // Filter whose completion function is being called by the current thread. The execution has
+  // already finished, so the function may call the filter without waiting for it.
+  static thread_local Filter* completingFilter = nullptr;
+
   void Filter::setProgressMonitorFunction(ProgressMonitorFunction func, void* userPtr)
   {
     progressFunc = func;
     progressUserPtr = userPtr;
   }
 
+  void Filter::setCompletionFunction(CompletionFunction func, void* userPtr)
+  {
+    completionFunc = func;
+    completionUserPtr = userPtr;
+  }
+
+  // Executes the filter in a task enqueued in the arena of the device, so it runs on the
+  // threads of the device. There is at most one pending execution per filter because all
+  // other calls on the filter wait for it first, except the calls from its completion
+  // function. The execution is pending until the completion function has returned.
+  void Filter::executeAsync()
+  {
+    if (dirty)
+      throw Exception(Error::InvalidOperation, "changes to the filter are not committed");
+
+    int execution;
+    {
+      std::lock_guard<std::mutex> lock(asyncMutex);
+      asyncPending = true;
+      asyncError = Error::None;
+      execution = ++asyncExecution;
+    }
+
+    incRef(); // released by the task
+    device->enqueueTask([this, execution]()
+    {
+      Error code = Error::None;
+      std::string message;
+
+      try
+      {
+        std::lock_guard<std::mutex> lock(getMutex());
+        execute();
+      }
+      catch (Exception& e)
+      {
+        code = e.code();
+        message = e.what();
+      }
+      catch (std::bad_alloc&)
+      {
+        code = Error::OutOfMemory;
+        message = "out of memory";
+      }
+      catch (std::exception& e)
+      {
+        code = Error::Unknown;
+        message = e.what();
+      }
+      catch (...)
+      {
+        code = Error::Unknown;
+        message = "unknown exception caught";
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(asyncMutex);
+        asyncError = code;
+        asyncErrorMessage = message;
+      }
+
+      if (completionFunc)
+      {
+        completingFilter = this;
+        completionFunc(completionUserPtr, code, (code == Error::None) ? nullptr : message.c_str());
+        completingFilter = nullptr;
+      }
+
+      // The completion function may have started the next execution
+      {
+        std::lock_guard<std::mutex> lock(asyncMutex);
+        if (asyncExecution == execution)
+          asyncPending = false;
+      }
+      asyncCond.notify_all();
+
+      // Destroy the filter with the device locked if it was released in the meantime
+      if (decRefKeep() == 0)
+      {
+        Ref<Device> device = this->device;
+        std::lock_guard<std::mutex> lock(device->getMutex());
+        destroy();
+      }
+    });
+  }
+
+  void Filter::wait()
+  {
+    if (completingFilter == this)
+      return;
+
+    std::unique_lock<std::mutex> lock(asyncMutex);
+    asyncCond.wait(lock, [&]() { return !asyncPending; });
+  }
+
+  bool Filter::isPending()
+  {
+    if (completingFilter == this)
+      return false;
+
+    std::lock_guard<std::mutex> lock(asyncMutex);
+    return asyncPending;
+  }
+
+  // Throws the error of the last asynchronous execution if it has not been reported yet
+  void Filter::checkAsyncError()
+  {
+    std::lock_guard<std::mutex> lock(asyncMutex);
+    if (asyncError != Error::None)
+    {
+      const Error code = asyncError;
+      asyncError = Error::None;
+      throw Exception(code, asyncErrorMessage.c_str());
+    }
+  }
+
   void Filter::setParam(int& dst, int src)
   {
     dirtyParam |= dst != src;
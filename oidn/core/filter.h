@@ -7,6 +7,7 @@
 #include "device.h"
 #include "image.h"
 #include "data.h"
+#include <condition_variable>
 
 namespace oidn {
 
@@ -14,6 +15,7 @@ namespace oidn {
   {
   protected:
     Ref<Device> device;
+    std::mutex mutex; // used only if the filters of the device are concurrent
 
     ProgressMonitorFunction progressFunc = nullptr;
     void* progressUserPtr = nullptr;
@@ -21,6 +23,17 @@ namespace oidn {
     bool dirty = true;
     bool dirtyParam = true;
 
+  private:
+    // Asynchronous execution
+    std::mutex asyncMutex;
+    std::condition_variable asyncCond;
+    bool asyncPending = false;
+    int asyncExecution = 0; // index of the last asynchronous execution
+    Error asyncError = Error::None; // error of the last asynchronous execution, until reported
+    std::string asyncErrorMessage;
+    CompletionFunction completionFunc = nullptr;
+    void* completionUserPtr = nullptr;
+
   public:
     explicit Filter(const Ref<Device>& device) : device(device) {}
 
@@ -39,8 +52,18 @@ namespace oidn {
     virtual void commit() = 0;
     virtual void execute(bool sync = true) = 0;
 
+    void setCompletionFunction(CompletionFunction func, void* userPtr);
+    void executeAsync();
+    void wait();
+    bool isPending();
+    void checkAsyncError();
+
     Device* getDevice() { return device.get(); }
 
+    // Returns the mutex which serializes the operations on the filter: the mutex of the
+    // device, or the own mutex of the filter if the filters of the device are concurrent
+    std::mutex& getMutex() { return device->hasConcurrentFilters() ? mutex : device->getMutex(); }
+
   protected:
     void setParam(int& dst, int src);
     void setParam(bool& dst, int src);
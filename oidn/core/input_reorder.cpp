@@ -21,8 +21,9 @@ namespace oidn {
     assert(dst->ndims() == 3);
     assert(dst->layout == TensorLayout::chw ||
            dst->layout == TensorLayout::Chw8c ||
-           dst->layout == TensorLayout::Chw16c);
-    assert(dst->blockSize() == device->getTensorBlockSize());
+           dst->layout == TensorLayout::Chw16c ||
+           dst->layout == TensorLayout::hwc);
+    assert(dst->layout == TensorLayout::hwc || dst->blockSize() == device->getTensorBlockSize());
 
     setTile(0, 0, 0, 0, 0, 0);
   }
@@ -48,6 +49,18 @@ namespace oidn {
     tile.W = W;
   }
 
+  double InputReorderNode::getByteCount() const
+  {
+    // The tile is read from the input images and the whole destination is written (including padding)
+    double srcByteCount = 0;
+    for (Image* image : {color.get(), albedo.get(), normal.get()})
+    {
+      if (image)
+        srcByteCount += double(tile.H) * tile.W * image->elementByteSize();
+    }
+    return srcByteCount + double(dst->byteSize());
+  }
+
   CPUInputReorderNode::CPUInputReorderNode(const Ref<Device>& device,
                                            const std::string& name,
                                            const std::shared_ptr<Tensor>& dst,
@@ -36,6 +36,8 @@ namespace oidn {
 
     std::shared_ptr<Tensor> getDst() const override { return dst; }
 
+    double getByteCount() const override;
+
   protected:
     Image* getInput()
     {
@@ -0,0 +1,103 @@
+// Copyright 2009-2021 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#include "memory_pool.h"
+
+namespace oidn {
+
+  MemoryPool& MemoryPool::get()
+  {
+    // Never destroyed, buffers may be freed during static destruction
+    static MemoryPool* pool = new MemoryPool;
+    return *pool;
+  }
+
+  MemoryPool::MemoryPool()
+  {
+    size_t maxCachedSizeMB = 1024;
+    getEnvVar("OIDN_MEMORY_POOL_SIZE", maxCachedSizeMB);
+    maxCachedSize = maxCachedSizeMB << 20;
+  }
+
+  MemoryBlock MemoryPool::alloc(size_t size, bool& isNew)
+  {
+    MemoryBlock block;
+    block.size = round_up(size, hugePageSize);
+    block.node = getCurrentNUMANode();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (block.node < int(freeBlocks.size()))
+      {
+        // Reuse the smallest free block of the node which does not waste too much memory
+        auto& nodeBlocks = freeBlocks[block.node];
+        auto it = nodeBlocks.lower_bound(block.size);
+        if (it != nodeBlocks.end() && it->first <= block.size + block.size / 4)
+        {
+          block.ptr = it->second;
+          block.size = it->first;
+          cachedSize -= block.size;
+          nodeBlocks.erase(it);
+          isNew = false;
+          return block;
+        }
+      }
+    }
+
+    block.ptr = (char*)allocPages(block.size);
+    isNew = true;
+    return block;
+  }
+
+  void MemoryPool::free(const MemoryBlock& block)
+  {
+    if (!block.ptr)
+      return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (block.size > maxCachedSize)
+    {
+      freePages(block.ptr, block.size);
+      return;
+    }
+
+    trim(maxCachedSize - block.size);
+    if (block.node >= int(freeBlocks.size()))
+      freeBlocks.resize(block.node + 1);
+    freeBlocks[block.node].emplace(block.size, block.ptr);
+    cachedSize += block.size;
+  }
+
+  void MemoryPool::addDevice()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    deviceCount++;
+  }
+
+  void MemoryPool::removeDevice()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--deviceCount == 0)
+      trim(0);
+  }
+
+  void MemoryPool::trim(size_t maxSize)
+  {
+    while (cachedSize > maxSize)
+    {
+      std::multimap<size_t, char*>* largestBlocks = nullptr;
+      for (auto& nodeBlocks : freeBlocks)
+      {
+        if (!nodeBlocks.empty() &&
+            (!largestBlocks || nodeBlocks.rbegin()->first > largestBlocks->rbegin()->first))
+          largestBlocks = &nodeBlocks;
+      }
+
+      auto it = std::prev(largestBlocks->end());
+      freePages(it->second, it->first);
+      cachedSize -= it->first;
+      largestBlocks->erase(it);
+    }
+  }
+
+} // namespace oidn
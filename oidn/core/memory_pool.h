@@ -0,0 +1,56 @@
+// Copyright 2009-2021 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "common.h"
+#include <vector>
+#include <map>
+#include <mutex>
+
+namespace oidn {
+
+  // Block of memory allocated from the memory pool
+  struct MemoryBlock
+  {
+    char* ptr = nullptr;
+    size_t size = 0; // multiple of hugePageSize
+    int node = 0;    // NUMA node of the thread which allocated the block (its pages may be
+                     // placed on other nodes by the first touch)
+  };
+
+  // Process-wide pool of large host memory blocks backed by huge pages where supported. Freed
+  // blocks are kept in a free list per NUMA node of the allocating thread and reused by later
+  // buffers of any device (e.g. the scratch and weights of the next filter) instead of being
+  // unmapped and faulted in again. The free blocks are returned to the OS when the last device is
+  // released.
+  class MemoryPool
+  {
+  private:
+    std::mutex mutex;
+    std::vector<std::multimap<size_t, char*>> freeBlocks; // free blocks by allocating node and size
+    size_t cachedSize = 0;                                // total size of the free blocks
+    size_t maxCachedSize;
+    int deviceCount = 0;                                  // number of live devices
+
+  public:
+    static MemoryPool& get();
+
+    // Returns a block of at least the given size from the free list of the NUMA node of the
+    // calling thread. A new block is returned untouched, so its pages are placed on the nodes of
+    // the threads which touch them first.
+    MemoryBlock alloc(size_t size, bool& isNew);
+    void free(const MemoryBlock& block);
+
+    // Registers a live device; the free blocks are released when the last one is removed
+    void addDevice();
+    void removeDevice();
+
+  private:
+    MemoryPool();
+
+    // Returns free blocks to the OS, largest first, until the cached size fits the limit
+    void trim(size_t maxSize);
+  };
+
+} // namespace oidn
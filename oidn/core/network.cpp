@@ -4,15 +4,20 @@
 #include "conv.h"
 #include "pool.h"
 #include "upsample.h"
+#include "concat.h"
 #include "color.h"
 #include "network.h"
 
 namespace oidn {
 
-  Network::Network(const Ref<Device>& device, const std::map<std::string, std::shared_ptr<Tensor>>& weightsMap)
+  Network::Network(const Ref<Device>& device, const std::map<std::string, std::shared_ptr<Tensor>>& weightsMap,
+                   const std::string& weightsKey, bool quantized)
     : device(device),
       K(device->getTensorBlockSize()),
-      weightsMap(weightsMap)
+      quantized(quantized),
+      profiling(device->isVerbose(4)),
+      weightsMap(weightsMap),
+      weightsKey(weightsKey)
   {
   }
 
@@ -20,42 +25,71 @@ namespace oidn {
   {
     for (size_t i = 0; i < nodes.size(); ++i)
     {
-      nodes[i]->execute();
+      if (profiling)
+      {
+        Timer timer;
+        nodes[i]->execute();
+        device->wait();
+
+        NodeStats& stats = nodeStats[i];
+        stats.count++;
+        stats.time  += timer.query();
+        stats.flops += nodes[i]->getFlopCount();
+        stats.bytes += nodes[i]->getByteCount();
+      }
+      else
+        nodes[i]->execute();
+
       progress.update(1);
     }
   }
 
+  void Network::resetNodeStats()
+  {
+    nodeStats.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+      nodeStats[i] = NodeStats();
+      nodeStats[i].name = nodes[i]->getName();
+    }
+  }
+
   double Network::getWorkAmount() const
   {
     return double(nodes.size());
   }
 
-  void Network::allocScratch(size_t size)
+  void Network::setScratch(const Ref<ScratchBuffer>& scratch, ptrdiff_t baseOffset)
   {
-    assert(!scratch);
-    scratch = device->newScratchBuffer(size);
+    assert(!this->scratch);
+    this->scratch = scratch;
+    scratchBaseOffset = baseOffset;
   }
 
   std::shared_ptr<Tensor> Network::newTensor(const TensorDesc& desc, ptrdiff_t offset)
   {
     assert(scratch);
-    return scratch->newTensor(desc, offset);
+    return scratch->newTensor(desc, scratchBaseOffset + offset);
   }
 
   std::shared_ptr<Image> Network::newImage(const ImageDesc& desc, ptrdiff_t offset)
   {
     assert(scratch);
-    return scratch->newImage(desc, offset);
+    return scratch->newImage(desc, scratchBaseOffset + offset);
   }
 
   TensorDesc Network::getInputReorderDesc(const TensorDims& srcDims, int alignment)
   {
-    assert(srcDims.size() == 3); // CHW
+    assert(srcDims.size() == 3 || srcDims.size() == 4); // CHW or NCHW
+    const size_t c = srcDims.size() - 3;
 
     TensorDims dstDims = srcDims;
-    dstDims[0] = round_up(srcDims[0], K); // round up C
-    dstDims[1] = round_up(srcDims[1], int64_t(alignment)); // round up H
-    dstDims[2] = round_up(srcDims[2], int64_t(alignment)); // round up W
+    dstDims[c]   = round_up(srcDims[c],   K); // round up C
+    dstDims[c+1] = round_up(srcDims[c+1], int64_t(alignment)); // round up H
+    dstDims[c+2] = round_up(srcDims[c+2], int64_t(alignment)); // round up W
+
+    if (quantized)
+      return TensorDesc(dstDims, TensorLayout::hwc, DataType::UInt8, getActivationScale("input"));
 
     TensorLayout layout = K == 16 ? TensorLayout::Chw16c : (K == 8 ? TensorLayout::Chw8c : TensorLayout::chw);
     return TensorDesc(dstDims, layout, device->getTensorDataType());
@@ -87,11 +121,22 @@ namespace oidn {
 
   TensorDesc Network::getConvDesc(const std::string& name, const TensorDesc& srcDesc)
   {
-    assert(srcDesc.ndims() == 3); // CHW
+    assert(srcDesc.ndims() == 3 || srcDesc.ndims() == 4); // CHW or NCHW
 
     const auto& bias = weightsMap[name + ".bias"];
     TensorDims dstDims = srcDesc.dims;
-    dstDims[0] = round_up(bias->dims[0], K); // dstDims[C] = round_up(OC, K)
+    dstDims[srcDesc.ndims()-3] = round_up(bias->dims[0], K); // dstDims[C] = round_up(OC, K)
+
+    // Quantized convolutions produce u8 activations, except the last one (without
+    // a calibrated output scale), which produces f32 for the output reorder
+    if (srcDesc.dataType == DataType::UInt8)
+    {
+      if (weightsMap.find(name + ".output_scale") != weightsMap.end())
+        return TensorDesc(dstDims, srcDesc.layout, DataType::UInt8, getActivationScale(name));
+      else
+        return TensorDesc(dstDims, srcDesc.layout, DataType::Float32);
+    }
+
     return TensorDesc(dstDims, srcDesc.layout, srcDesc.dataType);
   }
 
@@ -102,34 +147,114 @@ namespace oidn {
   {
     assert(dst->desc() == getConvDesc(name, src->desc()));
 
-    // Get and pad the weights
-    auto weights = weightsMap[name + ".weight"];
+    std::shared_ptr<Tensor> weights, bias;
+    std::vector<float> outputScales;
+    getConvParams(name, src->desc(), dst->desc(), weights, bias, outputScales);
+
+  #if defined(OIDN_DNNL)
+    auto node = std::make_shared<ConvNode>(device, name, src, weights, bias, dst, relu, outputScales, weightsKey);
+  #else
+    auto node = std::make_shared<ConvNode>(device, name, src, weights, bias, dst, relu);
+  #endif
+
+    nodes.push_back(node);
+    return node;
+  }
+
+  bool Network::isConvPoolSupported() const
+  {
+  #if defined(OIDN_DNNL)
+    // The bands of the fused node are always computed with direct convolution
+    return device->getConvAlgo() == ConvAlgo::Direct;
+  #else
+    return false;
+  #endif
+  }
+
+  std::shared_ptr<Node> Network::addConvPool(const std::string& name,
+                                             const std::shared_ptr<Tensor>& src,
+                                             const std::shared_ptr<Tensor>& dst)
+  {
+  #if defined(OIDN_DNNL)
+    const TensorDesc convDesc = getConvDesc(name, src->desc());
+    assert(dst->desc() == getPoolDesc(convDesc));
+
+    std::shared_ptr<Tensor> weights, bias;
+    std::vector<float> outputScales;
+    getConvParams(name, src->desc(), convDesc, weights, bias, outputScales);
+
+    auto node = std::make_shared<ConvPoolNode>(device, name, src, weights, bias, dst, outputScales, weightsKey);
+
+    nodes.push_back(node);
+    return node;
+  #else
+    throw Exception(Error::InvalidOperation, "fused convolution and pooling is not supported");
+  #endif
+  }
+
+  // Returns the padded (and possibly quantized) weights and biases of a convolution,
+  // and its output scales if quantized
+  void Network::getConvParams(const std::string& name,
+                              const TensorDesc& srcDesc,
+                              const TensorDesc& dstDesc,
+                              std::shared_ptr<Tensor>& weights,
+                              std::shared_ptr<Tensor>& bias,
+                              std::vector<float>& outputScales)
+  {
+    // Get the weights
+    weights = weightsMap[name + ".weight"];
     if (weights->ndims() != 4 || weights->layout != TensorLayout::oihw)
-      throw Exception(Error::InvalidOperation, "invalid convolution weights");  
-    if (K > 1)
-      weights = padWeights(weights);
+      throw Exception(Error::InvalidOperation, "invalid convolution weights");
+    const std::vector<float> weightScales = getWeightScales(name, weights);
 
     // Get and pad the biases
-    auto bias = weightsMap[name + ".bias"];
-    if (bias->ndims() != 1)
+    bias = weightsMap[name + ".bias"];
+    if (bias->ndims() != 1 || bias->dataType != DataType::Float32)
       throw Exception(Error::InvalidOperation, "invalid convolution biases");
     if (K > 1)
       bias = padBias(bias);
 
-    // Create the convolution node
-    auto node = std::make_shared<ConvNode>(device, name, src, weights, bias, dst, relu);
-    nodes.push_back(node);
-    return node;
+    if (srcDesc.dataType == DataType::UInt8)
+    {
+    #if defined(OIDN_DNNL)
+      // Quantize and pad the weights
+      weights = quantizeWeights(weights, weightScales);
+
+      // The s32 accumulators have the scale of the source times the scale of the
+      // weights. The bias is converted to this scale and the output scales convert
+      // the result to the scale of the destination.
+      const int64_t OC = weights->dims[0];
+      const float dstScale = (dstDesc.dataType == DataType::UInt8) ? dstDesc.scale : 1.f;
+      std::vector<float> accumScales(OC);
+      outputScales.resize(OC);
+      for (int64_t o = 0; o < OC; ++o)
+      {
+        accumScales[o]  = srcDesc.scale * (o < int64_t(weightScales.size()) ? weightScales[o] : 1.f);
+        outputScales[o] = accumScales[o] / dstScale;
+      }
+      bias = quantizeBias(bias, accumScales);
+    #else
+      throw Exception(Error::InvalidOperation, "quantized convolutions are not supported");
+    #endif
+    }
+    else
+    {
+      // Dequantize and pad the weights
+      if (weights->dataType == DataType::Int8)
+        weights = dequantizeWeights(weights, weightScales);
+      else if (K > 1)
+        weights = padWeights(weights);
+    }
   }
 
   TensorDesc Network::getPoolDesc(const TensorDesc& srcDesc)
   {
-    assert(srcDesc.ndims() == 3); // CHW
+    assert(srcDesc.ndims() == 3 || srcDesc.ndims() == 4); // CHW or NCHW
 
     TensorDims dstDims = srcDesc.dims;
-    dstDims[1] /= 2; // H/2
-    dstDims[2] /= 2; // W/2
-    return TensorDesc(dstDims, srcDesc.layout, srcDesc.dataType);
+    dstDims[srcDesc.ndims()-2] /= 2; // H/2
+    dstDims[srcDesc.ndims()-1] /= 2; // W/2
+    return TensorDesc(dstDims, srcDesc.layout, srcDesc.dataType, srcDesc.scale);
   }
 
   std::shared_ptr<Node> Network::addPool(const std::string& name,
@@ -146,19 +271,23 @@ namespace oidn {
 
   TensorDesc Network::getUpsampleDesc(const TensorDesc& srcDesc)
   {
-    assert(srcDesc.ndims() == 3); // CHW
+    assert(srcDesc.ndims() == 3 || srcDesc.ndims() == 4); // CHW or NCHW
 
     TensorDims dstDims = srcDesc.dims;
-    dstDims[1] *= 2; // H*2
-    dstDims[2] *= 2; // W*2
-    return TensorDesc(dstDims, srcDesc.layout, srcDesc.dataType);
+    dstDims[srcDesc.ndims()-2] *= 2; // H*2
+    dstDims[srcDesc.ndims()-1] *= 2; // W*2
+    return TensorDesc(dstDims, srcDesc.layout, srcDesc.dataType, srcDesc.scale);
   }
 
   std::shared_ptr<Node> Network::addUpsample(const std::string& name,
                                              const std::shared_ptr<Tensor>& src,
                                              const std::shared_ptr<Tensor>& dst)
   {
-    assert(dst->desc() == getUpsampleDesc(src->desc()));
+    // The destination may also be a concatenated tensor with more channels
+    assert(dst->batchSize() == src->batchSize());
+    assert(dst->numChannels() >= src->numChannels());
+    assert(dst->height() == getUpsampleDesc(src->desc()).height());
+    assert(dst->width()  == getUpsampleDesc(src->desc()).width());
 
     auto node = std::make_shared<CPUUpsampleNode>(device, name, src, dst);
 
@@ -169,25 +298,72 @@ namespace oidn {
   TensorDesc Network::getConcatDesc(const std::vector<TensorDesc>& srcDescs)
   {
     assert(!srcDescs.empty());
-    assert(srcDescs[0].ndims() == 3); // CHW
+    assert(srcDescs[0].ndims() == 3 || srcDescs[0].ndims() == 4); // CHW or NCHW
+    const int c = srcDescs[0].ndims() - 3;
 
     TensorDims dstDims = srcDescs[0].dims;
     for (size_t i = 1; i < srcDescs.size(); ++i)
     {
-      assert(srcDescs[i].ndims() == 3); // CHW
-      assert(srcDescs[i].dims[1] == srcDescs[0].dims[1]); // H
-      assert(srcDescs[i].dims[2] == srcDescs[0].dims[2]); // W
+      assert(srcDescs[i].ndims() == srcDescs[0].ndims());
+      assert(srcDescs[i].batchSize() == srcDescs[0].batchSize()); // N
+      assert(srcDescs[i].height() == srcDescs[0].height()); // H
+      assert(srcDescs[i].width()  == srcDescs[0].width());  // W
       assert(srcDescs[i].layout == srcDescs[0].layout);
       assert(srcDescs[i].dataType == srcDescs[0].dataType);
-      dstDims[0] += srcDescs[i].dims[0]; // C
+      if (srcDescs[i].scale != srcDescs[0].scale)
+        throw Exception(Error::InvalidOperation, "concatenated tensors have different quantization scales");
+      dstDims[c] += srcDescs[i].numChannels(); // C
     }
-    return TensorDesc(dstDims, srcDescs[0].layout, srcDescs[0].dataType);
+    return TensorDesc(dstDims, srcDescs[0].layout, srcDescs[0].dataType, srcDescs[0].scale);
+  }
+
+  std::shared_ptr<Node> Network::addConcat(const std::string& name,
+                                           const std::shared_ptr<Tensor>& src,
+                                           const std::shared_ptr<Tensor>& dst,
+                                           int dstChannelOffset)
+  {
+    auto node = std::make_shared<ConcatNode>(device, name, src, dst, dstChannelOffset);
+
+    nodes.push_back(node);
+    return node;
+  }
+
+  bool Network::isUpsampleConvSupported() const
+  {
+  #if defined(OIDN_DNNL)
+    // The partial convolutions are always direct and accumulated in f32
+    return device->getConvAlgo() == ConvAlgo::Direct && !quantized;
+  #else
+    return false;
+  #endif
+  }
+
+  std::shared_ptr<Node> Network::addUpsampleConv(const std::string& name,
+                                                 const std::shared_ptr<Tensor>& src,
+                                                 const std::shared_ptr<Tensor>& skip,
+                                                 const std::shared_ptr<Tensor>& dst)
+  {
+  #if defined(OIDN_DNNL)
+    const TensorDesc concatDesc = getConcatDesc({getUpsampleDesc(src->desc()), skip->desc()});
+    assert(dst->desc() == getConvDesc(name, concatDesc));
+
+    std::shared_ptr<Tensor> weights, bias;
+    std::vector<float> outputScales;
+    getConvParams(name, concatDesc, dst->desc(), weights, bias, outputScales);
+
+    auto node = std::make_shared<UpsampleConvNode>(device, name, src, skip, weights, bias, dst, weightsKey);
+
+    nodes.push_back(node);
+    return node;
+  #else
+    throw Exception(Error::InvalidOperation, "fused upsampling and convolution is not supported");
+  #endif
   }
 
   void Network::finalize()
   {
     // Compute the size of the scratch memory for the nodes
-    size_t nodeScratchSize = 0;
+    nodeScratchSize = 0;
     for (const auto& node : nodes)
       nodeScratchSize = max(nodeScratchSize, node->getScratchSize());
 
@@ -202,15 +378,7 @@ namespace oidn {
     // Free the weights
     weightsMap.clear();
 
-    // Print statistics
-    if (device->isVerbose(2))
-    {
-      const size_t scratchSize = scratch ? scratch->size() : 0;
-      const size_t totalScratchSize = scratchSize + nodeScratchSize;
-      std::cout << "Tensor scratch bytes: " << scratchSize << std::endl;
-      std::cout << "Node scratch bytes  : " << nodeScratchSize << std::endl;
-      std::cout << "Total scratch bytes : " << totalScratchSize << std::endl;
-    }
+    resetNodeStats();
   }
 
   std::shared_ptr<Tensor> Network::padWeights(const std::shared_ptr<Tensor>& src)
@@ -274,4 +442,147 @@ namespace oidn {
     return dst;
   }
 
+  // Returns the calibrated scale of the u8 activations produced by a node
+  float Network::getActivationScale(const std::string& name)
+  {
+    auto it = weightsMap.find(name + ".output_scale");
+    if (it == weightsMap.end())
+      throw Exception(Error::InvalidOperation, "missing activation quantization scale");
+
+    const auto& scale = it->second;
+    if (scale->ndims() != 1 || scale->dims[0] != 1 || scale->dataType != DataType::Float32)
+      throw Exception(Error::InvalidOperation, "invalid activation quantization scale");
+
+    const float value = scale->get<float>(0);
+    if (!(value > 0.f) || !std::isfinite(value))
+      throw Exception(Error::InvalidOperation, "invalid activation quantization scale");
+    return value;
+  }
+
+  // Returns the per-output-channel scales of the weights of a convolution, which
+  // are either stored in the weights blob or derived from the f32 weights
+  std::vector<float> Network::getWeightScales(const std::string& name, const std::shared_ptr<Tensor>& weights)
+  {
+    const int64_t O = weights->dims[0];
+    std::vector<float> scales(O);
+
+    auto it = weightsMap.find(name + ".weight_scale");
+    if (it != weightsMap.end())
+    {
+      const auto& src = it->second;
+      if (src->ndims() != 1 || src->dims[0] != O || src->dataType != DataType::Float32)
+        throw Exception(Error::InvalidOperation, "invalid convolution weight scales");
+      for (int64_t o = 0; o < O; ++o)
+        scales[o] = src->get<float>(o);
+    }
+    else
+    {
+      if (weights->dataType != DataType::Float32)
+        throw Exception(Error::InvalidOperation, "missing convolution weight scales");
+      if (!quantized)
+        return {};
+
+      const int64_t N = weights->numElements() / O;
+      const float* weightsPtr = (const float*)weights->data();
+      for (int64_t o = 0; o < O; ++o)
+      {
+        float maxAbs = 0.f;
+        for (int64_t i = 0; i < N; ++i)
+          maxAbs = max(maxAbs, std::abs(weightsPtr[o * N + i]));
+        scales[o] = maxAbs > 0.f ? maxAbs / 127.f : 1.f;
+      }
+    }
+
+    return scales;
+  }
+
+  std::shared_ptr<Tensor> Network::quantizeWeights(const std::shared_ptr<Tensor>& src, const std::vector<float>& scales)
+  {
+    assert(src->layout == TensorLayout::oihw);
+    assert(src->dataType == DataType::Float32 || src->dataType == DataType::Int8);
+
+    const int64_t O1 = src->dims[0];
+    const int64_t I1 = src->dims[1];
+    const int64_t O2 = round_up(O1, K);
+    const int64_t I2 = round_up(I1, K);
+    const int64_t H = src->dims[2];
+    const int64_t W = src->dims[3];
+
+    auto dst = std::make_shared<Tensor>(device, TensorDims({O2, I2, H, W}), TensorLayout::oihw, DataType::Int8);
+
+    for (int64_t o = 0; o < O2; ++o)
+    {
+      for (int64_t i = 0; i < I2; ++i)
+      {
+        for (int64_t h = 0; h < H; ++h)
+        {
+          for (int64_t w = 0; w < W; ++w)
+          {
+            int8_t value = 0; // padding
+            if (o < O1 && i < I1)
+            {
+              if (src->dataType == DataType::Int8)
+                value = src->get<int8_t>(o, i, h, w);
+              else
+                value = int8_t(clamp(std::nearbyint(src->get<float>(o, i, h, w) / scales[o]), -127.f, 127.f));
+            }
+
+            dst->get<int8_t>(o, i, h, w) = value;
+          }
+        }
+      }
+    }
+
+    return dst;
+  }
+
+  std::shared_ptr<Tensor> Network::dequantizeWeights(const std::shared_ptr<Tensor>& src, const std::vector<float>& scales)
+  {
+    assert(src->layout == TensorLayout::oihw);
+    assert(src->dataType == DataType::Int8);
+
+    const int64_t O1 = src->dims[0];
+    const int64_t I1 = src->dims[1];
+    const int64_t O2 = round_up(O1, K);
+    const int64_t I2 = round_up(I1, K);
+    const int64_t H = src->dims[2];
+    const int64_t W = src->dims[3];
+
+    auto dst = std::make_shared<Tensor>(device, TensorDims({O2, I2, H, W}), TensorLayout::oihw, DataType::Float32);
+
+    for (int64_t o = 0; o < O2; ++o)
+    {
+      for (int64_t i = 0; i < I2; ++i)
+      {
+        for (int64_t h = 0; h < H; ++h)
+        {
+          for (int64_t w = 0; w < W; ++w)
+          {
+            float value = 0; // padding
+            if (o < O1 && i < I1)
+              value = float(src->get<int8_t>(o, i, h, w)) * scales[o];
+
+            dst->get<float>(o, i, h, w) = value;
+          }
+        }
+      }
+    }
+
+    return dst;
+  }
+
+  std::shared_ptr<Tensor> Network::quantizeBias(const std::shared_ptr<Tensor>& src, const std::vector<float>& scales)
+  {
+    assert(src->layout == TensorLayout::x);
+    assert(src->dims[0] == int64_t(scales.size()));
+
+    const int64_t X = src->dims[0];
+    auto dst = std::make_shared<Tensor>(device, TensorDims({X}), TensorLayout::x, DataType::Float32);
+
+    for (int64_t x = 0; x < X; ++x)
+      dst->get<float>(x) = src->get<float>(x) / scales[x];
+
+    return dst;
+  }
+
 } // namespace oidn
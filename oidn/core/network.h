@@ -9,6 +9,7 @@
 #include "output_reorder.h"
 #include "progress.h"
 #include "scratch.h"
+#include "common/timer.h"
 
 #pragma once
 
@@ -17,16 +18,35 @@ namespace oidn {
   class Network
   {
   public:
-    Network(const Ref<Device>& device, const std::map<std::string, std::shared_ptr<Tensor>>& weightsMap);
+    // Profiling statistics of a node, accumulated over the executions since the last reset
+    struct NodeStats
+    {
+      std::string name;
+      int count = 0;    // number of executions
+      double time = 0;  // execution time in seconds
+      double flops = 0; // arithmetic operations
+      double bytes = 0; // bytes read and written
+    };
+
+    Network(const Ref<Device>& device, const std::map<std::string, std::shared_ptr<Tensor>>& weightsMap,
+            const std::string& weightsKey = "", bool quantized = false);
 
     void execute(Progress& progress);
     double getWorkAmount() const;
 
-    // Scratch memory
-    void allocScratch(size_t size);
+    // Profiling (enabled in verbose mode 4), which synchronizes the device after each node
+    bool isProfiling() const { return profiling; }
+    const std::vector<NodeStats>& getNodeStats() const { return nodeStats; }
+    void resetNodeStats();
+
+    // Scratch memory (offsets are relative to the base offset of the network)
+    void setScratch(const Ref<ScratchBuffer>& scratch, ptrdiff_t baseOffset = 0);
     std::shared_ptr<Tensor> newTensor(const TensorDesc& desc, ptrdiff_t offset);
     std::shared_ptr<Image> newImage(const ImageDesc& desc, ptrdiff_t offset);
 
+    // Size of the scratch memory of the nodes, which is private to the network (valid after finalize)
+    size_t getNodeScratchSize() const { return nodeScratchSize; }
+
     TensorDesc getInputReorderDesc(const TensorDims& srcDims, int alignment);
 
     std::shared_ptr<InputReorderNode> addInputReorder(const std::string& name,
@@ -47,6 +67,12 @@ namespace oidn {
                                   const std::shared_ptr<Tensor>& dst,
                                   bool relu = true);
 
+    // Convolution with relu fused with the following 2x2 max pooling (dst is the pooled tensor)
+    bool isConvPoolSupported() const;
+    std::shared_ptr<Node> addConvPool(const std::string& name,
+                                      const std::shared_ptr<Tensor>& src,
+                                      const std::shared_ptr<Tensor>& dst);
+
     TensorDesc getPoolDesc(const TensorDesc& srcDesc);
     std::shared_ptr<Node> addPool(const std::string& name,
                                   const std::shared_ptr<Tensor>& src,
@@ -58,19 +84,49 @@ namespace oidn {
                                       const std::shared_ptr<Tensor>& dst);
 
     TensorDesc getConcatDesc(const std::vector<TensorDesc>& srcDescs);
+    std::shared_ptr<Node> addConcat(const std::string& name,
+                                    const std::shared_ptr<Tensor>& src,
+                                    const std::shared_ptr<Tensor>& dst,
+                                    int dstChannelOffset);
+
+    // Convolution with relu of the concatenation of the upsampled source and the skip tensor
+    bool isUpsampleConvSupported() const;
+    std::shared_ptr<Node> addUpsampleConv(const std::string& name,
+                                          const std::shared_ptr<Tensor>& src,
+                                          const std::shared_ptr<Tensor>& skip,
+                                          const std::shared_ptr<Tensor>& dst);
 
     void finalize();
 
   private:
     Ref<Device> device;
     int K; // block size of blocked tensor layouts
+    bool quantized; // int8 convolutions on u8 HWC activations with calibrated scales
+    bool profiling;
 
     std::vector<std::shared_ptr<Node>> nodes;
+    std::vector<NodeStats> nodeStats; // one per node
     std::map<std::string, std::shared_ptr<Tensor>> weightsMap;
+    std::string weightsKey; // key of the weights in the weights cache (empty if not cached)
     Ref<ScratchBuffer> scratch;
-
+    ptrdiff_t scratchBaseOffset = 0;
+    size_t nodeScratchSize = 0;
+
+    void getConvParams(const std::string& name,
+                       const TensorDesc& srcDesc,
+                       const TensorDesc& dstDesc,
+                       std::shared_ptr<Tensor>& weights,
+                       std::shared_ptr<Tensor>& bias,
+                       std::vector<float>& outputScales);
     std::shared_ptr<Tensor> padWeights(const std::shared_ptr<Tensor>& src);
     std::shared_ptr<Tensor> padBias(const std::shared_ptr<Tensor>& src);
+
+    // Quantization
+    float getActivationScale(const std::string& name);
+    std::vector<float> getWeightScales(const std::string& name, const std::shared_ptr<Tensor>& weights);
+    std::shared_ptr<Tensor> quantizeWeights(const std::shared_ptr<Tensor>& src, const std::vector<float>& scales);
+    std::shared_ptr<Tensor> dequantizeWeights(const std::shared_ptr<Tensor>& src, const std::vector<float>& scales);
+    std::shared_ptr<Tensor> quantizeBias(const std::shared_ptr<Tensor>& src, const std::vector<float>& scales);
   };
 
 } // namespace oidn
@@ -25,6 +25,10 @@ namespace oidn {
     virtual size_t getScratchSize() const { return 0; }
     virtual void setScratch(const std::shared_ptr<Tensor>& scratch) {}
 
+    // Amount of work done by an execution, used for profiling
+    virtual double getFlopCount() const { return 0; } // arithmetic operations (0 if memory-bound)
+    virtual double getByteCount() const { return 0; } // bytes read and written
+
     __forceinline Device* getDevice() { return device.get(); }
     __forceinline const std::string& getName() const { return name; }
   };
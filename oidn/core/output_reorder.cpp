@@ -21,8 +21,9 @@ namespace oidn {
     assert(src->ndims() == 3);
     assert(src->layout == TensorLayout::chw ||
            src->layout == TensorLayout::Chw8c ||
-           src->layout == TensorLayout::Chw16c);
-    assert(src->blockSize() == device->getTensorBlockSize());
+           src->layout == TensorLayout::Chw16c ||
+           src->layout == TensorLayout::hwc);
+    assert(src->layout == TensorLayout::hwc || src->blockSize() == device->getTensorBlockSize());
 
     setTile(0, 0, 0, 0, 0, 0);
   }
@@ -46,6 +47,14 @@ namespace oidn {
     tile.W = W;
   }
 
+  double OutputReorderNode::getByteCount() const
+  {
+    // The first 3 channels of the tile are read from the source and written to the output image
+    if (!output)
+      return 0;
+    return double(tile.H) * tile.W * (3 * src->elementByteSize() + output->elementByteSize());
+  }
+
   CPUOutputReorderNode::CPUOutputReorderNode(const Ref<Device>& device,
                                              const std::string& name,
                                              const std::shared_ptr<Tensor>& src,
@@ -31,6 +31,8 @@ namespace oidn {
 
     void setDst(const std::shared_ptr<Image>& output);
     void setTile(int hSrc, int wSrc, int hDst, int wDst, int H, int W);
+
+    double getByteCount() const override;
   };
 
   class CPUOutputReorderNode : public OutputReorderNode
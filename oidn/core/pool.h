@@ -45,6 +45,7 @@ namespace oidn {
     }
 
     std::shared_ptr<Tensor> getDst() const override { return dst; }
+    double getByteCount() const override { return double(src->byteSize() + dst->byteSize()); }
   };
 
 #else
@@ -85,6 +86,7 @@ namespace oidn {
     }
 
     std::shared_ptr<Tensor> getDst() const override { return dst; }
+    double getByteCount() const override { return double(src->byteSize() + dst->byteSize()); }
   };
 
 #endif
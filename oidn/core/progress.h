@@ -15,6 +15,7 @@ namespace oidn {
     void* userPtr;
     double total;   // maximum progress value
     double current; // current progress value
+    std::mutex mutex; // progress may be updated concurrently (e.g. by parallel tiles)
 
     // Calls the progress monitor function
     void update()
@@ -40,6 +41,7 @@ namespace oidn {
     void update(double done)
     {
       assert(done >= 0);
+      std::lock_guard<std::mutex> lock(mutex);
       current = std::min(current + done, total);
       update();
     }
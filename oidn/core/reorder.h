@@ -52,6 +52,7 @@ namespace oidn {
     }
 
     std::shared_ptr<Tensor> getDst() const override { return dst; }
+    double getByteCount() const override { return double(src->byteSize() + dst->byteSize()); }
   };
 
 #endif
@@ -51,6 +51,7 @@ namespace oidn {
     chw,
     Chw8c,  // blocked
     Chw16c, // blocked
+    hwc,    // channels last (quantized networks)
     oihw,
   };
 
@@ -60,11 +61,12 @@ namespace oidn {
     TensorDims   dims;
     TensorLayout layout;
     DataType     dataType;
+    float        scale = 1.f; // quantization scale of UInt8 tensors (value = scale * stored value)
 
     __forceinline TensorDesc() = default;
 
-    __forceinline TensorDesc(TensorDims dims, TensorLayout layout, DataType dataType)
-      : dims(dims), layout(layout), dataType(dataType) {}
+    __forceinline TensorDesc(TensorDims dims, TensorLayout layout, DataType dataType, float scale = 1.f)
+      : dims(dims), layout(layout), dataType(dataType), scale(scale) {}
 
     // Returns the number of dimensions
     __forceinline int ndims() const { return int(dims.size()); }
@@ -107,6 +109,20 @@ namespace oidn {
       }
     }
 
+    // Returns the number of batch items in the tensor (CHW tensors have a single item)
+    __forceinline int batchSize() const
+    {
+      return (ndims() == 4 && layout != TensorLayout::oihw) ? int(dims[0]) : 1;
+    }
+
+    // Returns the descriptor of a single batch item
+    __forceinline TensorDesc itemDesc() const
+    {
+      if (ndims() != 4 || layout == TensorLayout::oihw)
+        return *this;
+      return TensorDesc(TensorDims(dims.begin() + 1, dims.end()), layout, dataType, scale);
+    }
+
     // Returns the number of channels in the tensor
     __forceinline int numChannels() const
     {
@@ -136,12 +152,13 @@ namespace oidn {
 
     __forceinline bool operator ==(const TensorDesc& other) const
     {
-      return (dims == other.dims) && (layout == other.layout) && (dataType == other.dataType);
+      return (dims == other.dims) && (layout == other.layout) && (dataType == other.dataType) &&
+             (scale == other.scale);
     }
 
     __forceinline bool operator !=(const TensorDesc& other) const
     {
-      return (dims != other.dims) || (layout != other.layout) || (dataType != other.dataType);
+      return !(*this == other);
     }
     
   #if defined(OIDN_DNNL)
@@ -157,20 +174,25 @@ namespace oidn {
         dnnlFormat = dnnl::memory::format_tag::x;
         break;
       case TensorLayout::chw:
-        assert(ndims() == 3);
-        dnnlDims   = {1, dims[0], dims[1], dims[2]};
+        assert(ndims() == 3 || ndims() == 4);
+        dnnlDims   = ndims() == 4 ? dims : dnnl::memory::dims{1, dims[0], dims[1], dims[2]};
         dnnlFormat = dnnl::memory::format_tag::nchw;
         break;
       case TensorLayout::Chw8c:
-        assert(ndims() == 3);
-        dnnlDims   = {1, dims[0], dims[1], dims[2]};
+        assert(ndims() == 3 || ndims() == 4);
+        dnnlDims   = ndims() == 4 ? dims : dnnl::memory::dims{1, dims[0], dims[1], dims[2]};
         dnnlFormat = dnnl::memory::format_tag::nChw8c;
         break;
       case TensorLayout::Chw16c:
-        assert(ndims() == 3);
-        dnnlDims   = {1, dims[0], dims[1], dims[2]};
+        assert(ndims() == 3 || ndims() == 4);
+        dnnlDims   = ndims() == 4 ? dims : dnnl::memory::dims{1, dims[0], dims[1], dims[2]};
         dnnlFormat = dnnl::memory::format_tag::nChw16c;
         break;
+      case TensorLayout::hwc:
+        assert(ndims() == 3 || ndims() == 4);
+        dnnlDims   = ndims() == 4 ? dims : dnnl::memory::dims{1, dims[0], dims[1], dims[2]};
+        dnnlFormat = dnnl::memory::format_tag::nhwc;
+        break;
       case TensorLayout::oihw:
         assert(ndims() == 4);
         dnnlDims   = {dims[0], dims[1], dims[2], dims[3]};
@@ -189,9 +211,15 @@ namespace oidn {
       case DataType::Float16:
         dnnlType = dnnl::memory::data_type::f16;
         break;
+      case DataType::BFloat16:
+        dnnlType = dnnl::memory::data_type::bf16;
+        break;
       case DataType::UInt8:
         dnnlType = dnnl::memory::data_type::u8;
         break;
+      case DataType::Int8:
+        dnnlType = dnnl::memory::data_type::s8;
+        break;
       default:
         throw Exception(Error::Unknown, "invalid tensor data type");
       }
@@ -292,13 +320,32 @@ namespace oidn {
     operator ispc::TensorAccessor() const
     {
       assert(ndims() == 3);
-      assert(dataType == DataType::Float32);
+      return getItemAccessor(0);
+    }
+
+    // Converts a batch item to ISPC equivalent
+    ispc::TensorAccessor getItemAccessor(int n) const
+    {
+      assert(ndims() == 3 || ndims() == 4);
+      assert(n < batchSize());
 
       ispc::TensorAccessor result;
-      result.ptr = (float*)data();
+      result.ptr = (uint8_t*)data() + n * (byteSize() / batchSize());
       result.C = numChannels();
       result.H = height();
       result.W = width();
+      result.hwc = layout == TensorLayout::hwc;
+      result.scale = scale;
+
+      switch (dataType)
+      {
+      case DataType::Float32:  result.dataType = ispc::DataType_Float32;  break;
+      case DataType::BFloat16: result.dataType = ispc::DataType_BFloat16; break;
+      case DataType::UInt8:    result.dataType = ispc::DataType_UInt8;    break;
+      default:
+        throw Exception(Error::Unknown, "unsupported tensor data type");
+      }
+
       return result;
     }
 
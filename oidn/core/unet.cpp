@@ -4,6 +4,7 @@
 #include "tza.h"
 #include "output_copy.h"
 #include "unet.h"
+#include <tuple>
 
 // Default weights
 #if defined(OIDN_FILTER_RT)
@@ -26,6 +27,43 @@
 
 namespace oidn {
 
+  namespace
+  {
+    // Returns whether the mask has any positive value in the specified region
+    bool isOccupied(const Image& mask, int h, int w, int H, int W)
+    {
+      for (int i = h; i < h + H; ++i)
+      {
+        const char* row = mask.get(i, w);
+        for (int j = 0; j < W; ++j)
+        {
+          const char* value = row + j * mask.bytePixelStride;
+          if (mask.format == Format::Half ? *(const int16_t*)value > 0 // positive sign and non-zero
+                                          : *(const float*)value > 0.f)
+            return true;
+        }
+      }
+      return false;
+    }
+
+    // Returns a view of a region of the image
+    Image getRegion(Image& image, int h, int w, int H, int W)
+    {
+      return Image(image.get(h, w), image.format, W, H,
+                   0, image.bytePixelStride, image.rowStride * image.bytePixelStride);
+    }
+
+    // Returns whether an input image that overlaps the output has the same pixels as the output,
+    // i.e. every output pixel overwrites only its own input pixel
+    bool isAliased(const Image& output, const Image& input)
+    {
+      return !output.overlaps(input) ||
+             (input.ptr == output.ptr && input.format == output.format &&
+              input.width == output.width && input.height == output.height &&
+              input.bytePixelStride == output.bytePixelStride && input.rowStride == output.rowStride);
+    }
+  }
+
   // ---------------------------------------------------------------------------
   // UNetFilter
   // ---------------------------------------------------------------------------
@@ -95,6 +133,12 @@ namespace oidn {
                        (normal && output->overlaps(*normal)));
     setParam(inplace, inplaceNew);
 
+    bool inplaceAliasedNew = inplaceNew &&
+                             (!color  || isAliased(*output, *color))  &&
+                             (!albedo || isAliased(*output, *albedo)) &&
+                             (!normal || isAliased(*output, *normal));
+    setParam(inplaceAliased, inplaceAliasedNew);
+
     if (dirtyParam)
     {
       // (Re-)Initialize the filter
@@ -105,6 +149,27 @@ namespace oidn {
 
       device->wait();
     }
+    else if (mask && H > 0 && W > 0)
+    {
+      // The tiling was chosen for the mask of an earlier commit. It is kept for the current mask
+      // unless the tiling chosen for it computes at least minRetileGain fewer pixels, which is
+      // worth re-initializing the filter. Otherwise the tiles without occupied pixels are still
+      // skipped at execution.
+      device->executeTask([&]()
+      {
+        const auto tiling = std::make_tuple(tileH, tileW, tileCountH, tileCountW,
+                                            netBatchSize, netBatchCount, netInstanceCount);
+        const std::vector<int> maskBlockSums = getMaskBlockSums();
+        const double cost = getTilingCost(maskBlockSums);
+        computeTileSize(maskBlockSums);
+        if (getTilingCost(maskBlockSums) < cost * (1. - minRetileGain))
+          init();
+        else
+          std::tie(tileH, tileW, tileCountH, tileCountW, netBatchSize, netBatchCount, netInstanceCount) = tiling;
+      });
+
+      device->wait();
+    }
 
     dirty = false;
     dirtyParam = false;
@@ -120,69 +185,221 @@ namespace oidn {
 
     device->executeTask([&]()
     {
-      // Initialize the progress state
-      double workAmount = tileCountH * tileCountW * net->getWorkAmount();
-      if (outputTemp)
-        workAmount += 1;
-      Progress progress(progressFunc, progressUserPtr, workAmount);
+      Timer timer;
+      const bool profiling = netInstances[0].net->isProfiling();
+      if (profiling)
+      {
+        for (auto& instance : netInstances)
+        {
+          instance.net->resetNodeStats();
+          instance.tileTimes.clear();
+        }
+      }
 
-      // Set the input and output
-      inputReorder->setSrc(color, albedo, normal);
-      outputReorder->setDst(outputTemp ? outputTemp : output);
+      // Split the images into the stacked batch items and set their input scales
+      std::vector<std::shared_ptr<Image>> colorItems(batchSize), albedoItems(batchSize), normalItems(batchSize), outputItems(batchSize);
+      std::vector<std::shared_ptr<Image>> maskItems(batchSize);
+      std::vector<float> inputScales(batchSize);
 
-      // Set the input scale
-      if (isnan(inputScale))
+      for (int n = 0; n < batchSize; ++n)
       {
-        if (hdr)
-          transferFunc->setInputScale(getAutoexposure(*color));
+        colorItems[n]  = getBatchItem(color,  n);
+        albedoItems[n] = getBatchItem(albedo, n);
+        normalItems[n] = getBatchItem(normal, n);
+        outputItems[n] = getBatchItem(outputTemp ? outputTemp : output, n);
+        maskItems[n]   = getBatchItem(mask,   n);
+
+        if (isnan(inputScale))
+          inputScales[n] = hdr ? getAutoexposure(*colorItems[n]) : 1.f;
         else
-          transferFunc->setInputScale(1.f);
+          inputScales[n] = inputScale;
+      }
+
+      // Select the tiles to denoise. If there is a mask, tiles without any occupied pixel in
+      // their input region (which includes the receptive field of the output pixels) are
+      // skipped and their input color is copied to the output instead.
+      const int tileCount = batchSize * tileCountH * tileCountW;
+      std::vector<int> tiles; // indices of the denoised tiles
+
+      if (mask)
+      {
+        std::vector<char> occupied(tileCount);
+        parallel_nd(tileCount, [&](int tileIndex)
+        {
+          const Tile tile = getTile(tileIndex);
+          occupied[tileIndex] = isOccupied(*maskItems[tile.n], tile.h, tile.w, tile.H1, tile.W1);
+        });
+
+        for (int tileIndex = 0; tileIndex < tileCount; ++tileIndex)
+        {
+          if (occupied[tileIndex])
+          {
+            tiles.push_back(tileIndex);
+            continue;
+          }
+
+          // With an output ring the output is the color image, so the pixels are already in place
+          if (outputRing)
+            continue;
+
+          const Tile tile = getTile(tileIndex);
+          const int h = tile.h + tile.overlapBeginH;
+          const int w = tile.w + tile.overlapBeginW;
+          outputCopy(device, getRegion(*colorItems[tile.n], h, w, tile.H2, tile.W2),
+                             getRegion(*outputItems[tile.n], h, w, tile.H2, tile.W2));
+        }
       }
       else
       {
-        transferFunc->setInputScale(inputScale);
+        tiles.resize(tileCount);
+        for (int tileIndex = 0; tileIndex < tileCount; ++tileIndex)
+          tiles[tileIndex] = tileIndex;
       }
 
-      // Iterate over the tiles
-      int tileIndex = 0;
+      const int denoisedTileCount = int(tiles.size());
 
-      for (int i = 0; i < tileCountH; ++i)
+      // With an output ring, the tiles are denoised in steps of at most one network execution per
+      // instance. The output of a tile row is kept in the ring until the tiles of the next row,
+      // whose input overlaps it, have been denoised too, then it is flushed to the output image.
+      // A step takes only tiles whose row fits into the ring, so the rows of the ring are free.
+      const int tileRowCount = batchSize * tileCountH;
+      std::vector<int> stepEnds; // end of the tiles of each step
+      int executionCount = ceil_div(denoisedTileCount, netBatchSize);
+
+      // Returns the first tile row which must not be flushed yet before denoising the given tile
+      auto getFlushEnd = [&](int tileBegin)
       {
-        const int h = i * (tileH - 2*overlap); // input tile position (including overlap)
-        const int overlapBeginH = i > 0            ? overlap : 0; // overlap on the top
-        const int overlapEndH   = i < tileCountH-1 ? overlap : 0; // overlap on the bottom
-        const int tileH1 = min(H - h, tileH); // input tile size (including overlap)
-        const int tileH2 = tileH1 - overlapBeginH - overlapEndH; // output tile size
-        const int alignOffsetH = tileH - round_up(tileH1, alignment); // align to the bottom in the tile buffer
+        if (tileBegin == denoisedTileCount)
+          return tileRowCount;
+        const int row = tiles[tileBegin] / tileCountW;
+        return (row % tileCountH == 0) ? row : row - 1; // the row above is read by the tile
+      };
 
-        for (int j = 0; j < tileCountW; ++j)
+      if (outputRing)
+      {
+        executionCount = 0;
+        for (int tileBegin = 0; tileBegin < denoisedTileCount; )
         {
-          const int w = j * (tileW - 2*overlap); // input tile position (including overlap)
-          const int overlapBeginW = j > 0            ? overlap : 0; // overlap on the left
-          const int overlapEndW   = j < tileCountW-1 ? overlap : 0; // overlap on the right
-          const int tileW1 = min(W - w, tileW); // input tile size (including overlap)
-          const int tileW2 = tileW1 - overlapBeginW - overlapEndW; // output tile size
-          const int alignOffsetW = tileW - round_up(tileW1, alignment); // align to the right in the tile buffer
+          const int ringEnd = getFlushEnd(tileBegin) + outputRingRows; // first row beyond the ring
+          const int maxTileEnd = min(tileBegin + netInstanceCount * netBatchSize, denoisedTileCount);
+          int tileEnd = tileBegin;
+          while (tileEnd < maxTileEnd && tiles[tileEnd] / tileCountW < ringEnd)
+            ++tileEnd;
+
+          stepEnds.push_back(tileEnd);
+          executionCount += ceil_div(tileEnd - tileBegin, netBatchSize);
+          tileBegin = tileEnd;
+        }
+      }
 
-          // Set the input tile
-          inputReorder->setTile(h, w,
-                                alignOffsetH, alignOffsetW,
-                                tileH1, tileW1);
+      // Initialize the progress state
+      double workAmount = executionCount * netInstances[0].net->getWorkAmount();
+      if (outputTemp)
+        workAmount += 1;
+      Progress progress(progressFunc, progressUserPtr, workAmount);
+
+      // Denoises up to netBatchSize of the selected tiles with one network execution
+      auto executeBatch = [&](NetInstance& instance, int tileBegin, int tileEnd)
+      {
+        for (int k = 0; k < netBatchSize; ++k)
+        {
+          if (tileBegin + k >= tileEnd)
+          {
+            // Unused network batch item: zero the input and skip the output
+            instance.inputReorders[k]->setSrc(colorItems[0], albedoItems[0], normalItems[0]);
+            instance.inputReorders[k]->setTile(0, 0, 0, 0, 0, 0);
+            instance.outputReorders[k]->setDst(outputItems[0]);
+            instance.outputReorders[k]->setTile(0, 0, 0, 0, 0, 0);
+            continue;
+          }
+
+          const int tileIndex = tiles[tileBegin + k];
+          const Tile tile = getTile(tileIndex);
+          const int n = tile.n;
+
+          // Set the input
+          instance.inputReorders[k]->setSrc(colorItems[n], albedoItems[n], normalItems[n]);
+          instance.transferFuncs[k]->setInputScale(inputScales[n]);
 
-          // Set the output tile
-          outputReorder->setTile(alignOffsetH + overlapBeginH, alignOffsetW + overlapBeginW,
-                                 h + overlapBeginH, w + overlapBeginW,
-                                 tileH2, tileW2);
+          // Set the input tile
+          instance.inputReorders[k]->setTile(tile.h, tile.w,
+                                             tile.alignOffsetH, tile.alignOffsetW,
+                                             tile.H1, tile.W1);
+
+          // Set the output tile, in the output ring at the slot of its row if there is one
+          if (outputRing)
+          {
+            instance.outputReorders[k]->setDst(outputRing);
+            instance.outputReorders[k]->setTile(tile.alignOffsetH + tile.overlapBeginH, tile.alignOffsetW + tile.overlapBeginW,
+                                                (tileIndex / tileCountW) % outputRingRows * tileH, tile.w + tile.overlapBeginW,
+                                                tile.H2, tile.W2);
+          }
+          else
+          {
+            instance.outputReorders[k]->setDst(outputItems[n]);
+            instance.outputReorders[k]->setTile(tile.alignOffsetH + tile.overlapBeginH, tile.alignOffsetW + tile.overlapBeginW,
+                                                tile.h + tile.overlapBeginH, tile.w + tile.overlapBeginW,
+                                                tile.H2, tile.W2);
+          }
+        }
 
-          //printf("Tile: %d %d -> %d %d\n", w+overlapBeginW, h+overlapBeginH, w+overlapBeginW+tileW2, h+overlapBeginH+tileH2);
+        // Denoise the tiles
+        if (profiling)
+        {
+          Timer tileTimer;
+          instance.net->execute(progress);
+          instance.tileTimes.push_back({tiles[tileBegin], tileEnd - tileBegin, tileTimer.query()});
+        }
+        else
+          instance.net->execute(progress);
+      };
 
-          // Denoise the tile
-          net->execute(progress);
+      if (outputRing)
+      {
+        std::vector<char> denoised(tileCount);
+        for (int tileIndex : tiles)
+          denoised[tileIndex] = true;
 
-          // Next tile
-          tileIndex++;
+        // Copies the denoised tiles of a row from the output ring to the output image
+        auto flushRow = [&](int row)
+        {
+          for (int tileIndex = row * tileCountW; tileIndex < (row + 1) * tileCountW; ++tileIndex)
+          {
+            if (!denoised[tileIndex])
+              continue;
+
+            const Tile tile = getTile(tileIndex);
+            const int w = tile.w + tile.overlapBeginW;
+            outputCopy(device, getRegion(*outputRing, row % outputRingRows * tileH, w, tile.H2, tile.W2),
+                               getRegion(*outputItems[tile.n], tile.h + tile.overlapBeginH, w, tile.H2, tile.W2));
+          }
+        };
+
+        int tileBegin = 0;
+        int flushedRowCount = 0;
+        for (int tileEnd : stepEnds)
+        {
+          parallel_nd(ceil_div(tileEnd - tileBegin, netBatchSize), [&](int p)
+          {
+            const int batchBegin = tileBegin + p * netBatchSize;
+            executeBatch(netInstances[p], batchBegin, min(batchBegin + netBatchSize, tileEnd));
+          });
+          tileBegin = tileEnd;
+
+          for (const int flushEnd = getFlushEnd(tileBegin); flushedRowCount < flushEnd; ++flushedRowCount)
+            flushRow(flushedRowCount);
         }
       }
+      else
+      {
+        // Iterate over the selected tiles of all batch items, netBatchSize tiles at a time,
+        // distributing the network executions over the network instances
+        parallel_nd(netInstanceCount, [&](int p)
+        {
+          for (int tileBegin = p * netBatchSize; tileBegin < denoisedTileCount; tileBegin += netInstanceCount * netBatchSize)
+            executeBatch(netInstances[p], tileBegin, min(tileBegin + netBatchSize, denoisedTileCount));
+        });
+      }
 
       // Copy the output image to the final buffer if filtering in-place
       if (outputTemp)
@@ -190,62 +407,356 @@ namespace oidn {
 
       // Finished
       progress.finish();
+
+      if (profiling)
+      {
+        device->wait();
+        printProfile(timer.query());
+      }
     });
 
     if (sync)
       device->wait();
   }
 
-  void UNetFilter::computeTileSize()
+  // Prints the execution time of the nodes with the throughput of the convolutions in GFLOP/s
+  // and of the other nodes in GB/s, and the execution time of the tiles. There is a single
+  // network instance while profiling (see computeTileSize), so the tiles are denoised one
+  // network execution at a time.
+  void UNetFilter::printProfile(double totalTime)
+  {
+    const std::vector<Network::NodeStats>& stats = netInstances[0].net->getNodeStats();
+
+    double nodeTime = 0;
+    int nameWidth = 5;
+    for (const auto& nodeStats : stats)
+    {
+      nodeTime += nodeStats.time;
+      nameWidth = max(nameWidth, int(nodeStats.name.size()));
+    }
+
+    char line[256];
+    std::cout << "Profile (single network instance):" << std::endl;
+    snprintf(line, sizeof(line), "  %-*s %6s %11s %7s %s", nameWidth, "Node", "Calls", "Time [ms]", "%", "Throughput");
+    std::cout << line << std::endl;
+
+    for (const auto& nodeStats : stats)
+    {
+      const double percent = nodeTime > 0 ? nodeStats.time / nodeTime * 100 : 0;
+      int n = snprintf(line, sizeof(line), "  %-*s %6d %11.3f %7.1f",
+                       nameWidth, nodeStats.name.c_str(), nodeStats.count, nodeStats.time * 1000, percent);
+      if (nodeStats.time > 0 && nodeStats.flops > 0)
+        snprintf(line + n, sizeof(line) - n, " %7.1f GFLOP/s", nodeStats.flops / nodeStats.time * 1e-9);
+      else if (nodeStats.time > 0 && nodeStats.bytes > 0)
+        snprintf(line + n, sizeof(line) - n, " %7.1f GB/s", nodeStats.bytes / nodeStats.time * 1e-9);
+      std::cout << line << std::endl;
+    }
+
+    snprintf(line, sizeof(line), "  %-*s %6s %11.3f", nameWidth, "Nodes", "", nodeTime * 1000);
+    std::cout << line << std::endl;
+    snprintf(line, sizeof(line), "  %-*s %6s %11.3f", nameWidth, "Total", "", totalTime * 1000);
+    std::cout << line << std::endl;
+
+    // Each network execution denoises up to netBatchSize tiles
+    std::vector<TileTime> tileTimes;
+    for (const auto& instance : netInstances)
+      tileTimes.insert(tileTimes.end(), instance.tileTimes.begin(), instance.tileTimes.end());
+    std::sort(tileTimes.begin(), tileTimes.end(),
+              [](const TileTime& a, const TileTime& b) { return a.tile < b.tile; });
+
+    std::cout << "Tiles:" << std::endl;
+    for (const auto& tileTime : tileTimes)
+    {
+      std::string tiles = std::to_string(tileTime.tile);
+      if (tileTime.tileCount > 1)
+        tiles += " (" + std::to_string(tileTime.tileCount) + " tiles)";
+      snprintf(line, sizeof(line), "  %-12s %11.3f ms", tiles.c_str(), tileTime.time * 1000);
+      std::cout << line << std::endl;
+    }
+  }
+
+  // Returns the n-th of the batch items stacked vertically in the image
+  std::shared_ptr<Image> UNetFilter::getBatchItem(const std::shared_ptr<Image>& image, int n)
+  {
+    if (!image || batchSize == 1)
+      return image;
+
+    return std::make_shared<Image>(image->get(n * H, 0), image->format, image->width, H,
+                                   0, image->bytePixelStride, image->rowStride * image->bytePixelStride);
+  }
+
+  UNetFilter::Tile UNetFilter::getTile(int tileIndex) const
+  {
+    Tile tile;
+    tile.n = tileIndex / (tileCountH * tileCountW);
+    const int i = (tileIndex / tileCountW) % tileCountH;
+    const int j = tileIndex % tileCountW;
+
+    // Compute the tile in the H dimension
+    tile.h = i * (tileH - 2*overlap);                    // input tile position (including overlap)
+    tile.overlapBeginH = i > 0            ? overlap : 0; // overlap on the top
+    const int overlapEndH = i < tileCountH-1 ? overlap : 0; // overlap on the bottom
+    tile.H1 = min(H - tile.h, tileH);                    // input tile size (including overlap)
+    tile.H2 = tile.H1 - tile.overlapBeginH - overlapEndH; // output tile size
+    tile.alignOffsetH = tileH - round_up(tile.H1, alignment); // align to the bottom in the tile buffer
+
+    // Compute the tile in the W dimension
+    tile.w = j * (tileW - 2*overlap);                    // input tile position (including overlap)
+    tile.overlapBeginW = j > 0            ? overlap : 0; // overlap on the left
+    const int overlapEndW = j < tileCountW-1 ? overlap : 0; // overlap on the right
+    tile.W1 = min(W - tile.w, tileW);                    // input tile size (including overlap)
+    tile.W2 = tile.W1 - tile.overlapBeginW - overlapEndW; // output tile size
+    tile.alignOffsetW = tileW - round_up(tile.W1, alignment); // align to the right in the tile buffer
+
+    return tile;
+  }
+
+  // Returns the number of tile rows in the output ring. The tiles denoised concurrently span at
+  // most this many rows, including the row above them which is still read by the first of them.
+  int UNetFilter::getOutputRingRows(int tileCountH, int tileCountW, int netBatchSize, int netInstanceCount) const
+  {
+    return min(ceil_div(netInstanceCount * netBatchSize - 1, tileCountW) + 2, batchSize * tileCountH);
+  }
+
+  // Returns the size of the temporary output required for in-place tiled filtering (unless all
+  // tiles are denoised by a single network execution). If the output aliases the input, only the
+  // tile rows whose input is still read by later tiles are kept in a ring, otherwise the whole
+  // output image is stored.
+  size_t UNetFilter::getOutputTempSize(int tileH, int tileCountH, int tileCountW, int netBatchSize, int netInstanceCount) const
+  {
+    if (!inplace || tileCountH * tileCountW == 1 || batchSize * tileCountH * tileCountW <= netBatchSize)
+      return 0;
+
+    if (inplaceAliased)
+    {
+      const int ringRows = getOutputRingRows(tileCountH, tileCountW, netBatchSize, netInstanceCount);
+      return ImageDesc(output->format, W, ringRows * tileH).alignedByteSize();
+    }
+
+    return ImageDesc(output->format, W, output->height).alignedByteSize();
+  }
+
+  // With a mask, only the tiles with occupied pixels in their input region are denoised. The
+  // occupancy is tracked in blocks of pixels, and the occupied blocks of a region are counted
+  // with a summed area table per batch item, which this function returns (empty without a mask).
+  std::vector<int> UNetFilter::getMaskBlockSums()
+  {
+    std::vector<int> maskBlockSums;
+    if (!mask)
+      return maskBlockSums;
+
+    const int maskBlockCountH = ceil_div(H, maskBlockSize);
+    const int maskBlockCountW = ceil_div(W, maskBlockSize);
+    std::vector<char> occupied(size_t(batchSize) * maskBlockCountH * maskBlockCountW);
+    for (int n = 0; n < batchSize; ++n)
+    {
+      const std::shared_ptr<Image> maskItem = getBatchItem(mask, n);
+      parallel_nd(maskBlockCountH, maskBlockCountW, [&](int i, int j)
+      {
+        const int h = i * maskBlockSize;
+        const int w = j * maskBlockSize;
+        occupied[(size_t(n) * maskBlockCountH + i) * maskBlockCountW + j] =
+          isOccupied(*maskItem, h, w, min(maskBlockSize, H - h), min(maskBlockSize, W - w));
+      });
+    }
+
+    maskBlockSums.resize(size_t(batchSize) * (maskBlockCountH+1) * (maskBlockCountW+1));
+    for (int n = 0; n < batchSize; ++n)
+    {
+      int* sums = &maskBlockSums[size_t(n) * (maskBlockCountH+1) * (maskBlockCountW+1)];
+      for (int i = 0; i < maskBlockCountH; ++i)
+      {
+        for (int j = 0; j < maskBlockCountW; ++j)
+        {
+          sums[(i+1) * (maskBlockCountW+1) + (j+1)] =
+            occupied[(size_t(n) * maskBlockCountH + i) * maskBlockCountW + j] +
+            sums[i * (maskBlockCountW+1) + (j+1)] + sums[(i+1) * (maskBlockCountW+1) + j] -
+            sums[i * (maskBlockCountW+1) + j];
+        }
+      }
+    }
+    return maskBlockSums;
+  }
+
+  // Returns the number of denoised tiles for the given tiles. Counting the tiles with occupied
+  // blocks is skipped for tilings with too many tiles, which are rarely the cheapest.
+  int UNetFilter::getDenoisedTileCount(const std::vector<int>& maskBlockSums,
+                                       int tileH, int tileW, int tileCountH, int tileCountW) const
+  {
+    constexpr int maxMaskTileCount = 1024;
+    if (maskBlockSums.empty() || tileCountH * tileCountW > maxMaskTileCount)
+      return batchSize * tileCountH * tileCountW;
+
+    const int maskBlockCountH = ceil_div(H, maskBlockSize);
+    const int maskBlockCountW = ceil_div(W, maskBlockSize);
+    int denoisedTileCount = 0;
+    for (int n = 0; n < batchSize; ++n)
+    {
+      const int* sums = &maskBlockSums[size_t(n) * (maskBlockCountH+1) * (maskBlockCountW+1)];
+      for (int i = 0; i < tileCountH; ++i)
+      {
+        const int h = i * (tileH - 2*overlap);
+        const int i0 = h / maskBlockSize;
+        const int i1 = ceil_div(min(h + tileH, H), maskBlockSize);
+        for (int j = 0; j < tileCountW; ++j)
+        {
+          const int w = j * (tileW - 2*overlap);
+          const int j0 = w / maskBlockSize;
+          const int j1 = ceil_div(min(w + tileW, W), maskBlockSize);
+          if (sums[i1 * (maskBlockCountW+1) + j1] - sums[i0 * (maskBlockCountW+1) + j1] -
+              sums[i1 * (maskBlockCountW+1) + j0] + sums[i0 * (maskBlockCountW+1) + j0] > 0)
+            ++denoisedTileCount;
+        }
+      }
+    }
+    return denoisedTileCount;
+  }
+
+  // Returns the number of computed pixels of the current tiling for the given mask
+  double UNetFilter::getTilingCost(const std::vector<int>& maskBlockSums) const
+  {
+    return double(max(getDenoisedTileCount(maskBlockSums, tileH, tileW, tileCountH, tileCountW), 1)) * tileH * tileW;
+  }
+
+  void UNetFilter::computeTileSize(const std::vector<int>& maskBlockSums)
   {
     const int minTileSize = 3*overlap;
 
     // Compute the maximum allowed scratch size to fit into the requested memory limit
     const size_t maxScratchSize = size_t(maxMemoryMB)*1024*1024;
 
-    tileCountH = 1;
-    tileCountW = 1;
-    tileH = round_up(H, alignment);
-    tileW = round_up(W, alignment);
+    // Returns the scratch size for the given tiles, network batch size and network instance count,
+    // including the private node scratch of the network instances
+    auto getScratchSize = [&](int tileH, int tileW, int tileCountH, int tileCountW,
+                              int netBatchSize, int netInstanceCount) -> size_t
+    {
+      const double pixelScratchSize = (netBatchSize > 1) ? batchTileScratchSize : tileScratchSize;
+      const size_t instanceScratchSize = size_t(pixelScratchSize * netBatchSize * tileH * tileW) + instanceNodeScratchSize;
+      return netInstanceCount * instanceScratchSize +
+             getOutputTempSize(tileH, tileCountH, tileCountW, netBatchSize, netInstanceCount);
+    };
+
+    // Returns the smallest tile size that splits the image size into the given number of tiles
+    // (the tiles overlap, so only the interior of the image is split)
+    auto getTileSize = [&](int size, int tileCount)
+    {
+      if (tileCount == 1)
+        return round_up(size, alignment);
+      return max(round_up(ceil_div(size - 2*overlap, tileCount), alignment) + 2*overlap, minTileSize);
+    };
 
-    // Divide the image into tiles until the scratch size gets below the threshold
-    while (buildNet(true) > maxScratchSize)
+    auto getTileCount = [&](int size, int tileSize)
     {
-      if (tileH > minTileSize && tileH > tileW)
+      return (size > tileSize) ? ceil_div(size - 2*overlap, tileSize - 2*overlap) : 1;
+    };
+
+    // Returns the distinct tile sizes for a dimension, from the largest to the smallest
+    auto getTileSizes = [&](int size)
+    {
+      std::vector<int> tileSizes = {getTileSize(size, 1)};
+      for (int tileCount = 2; tileSizes.back() > minTileSize; ++tileCount)
       {
-        tileCountH++;
-        tileH = max(round_up(ceil_div(H - 2*overlap, tileCountH), alignment) + 2*overlap, minTileSize);
+        const int tileSize = getTileSize(size, tileCount);
+        if (tileSize < tileSizes.back())
+          tileSizes.push_back(tileSize);
       }
-      else if (tileW > minTileSize)
+      return tileSizes;
+    };
+
+    // Returns the number of denoised tiles for the given tiles
+    auto getDenoisedTileCount = [&](int tileH, int tileW, int tileCountH, int tileCountW)
+    {
+      return this->getDenoisedTileCount(maskBlockSums, tileH, tileW, tileCountH, tileCountW);
+    };
+
+    // Find the tile size and number of network instances with the least number of computed pixels
+    // (the overlapping pixels are computed more than once, the tiles are padded and tiles without
+    // occupied pixels are skipped) that fit into the memory limit, preferring more instances for
+    // the same cost. If none of them fits, use the tile size with the smallest scratch size.
+    const std::vector<int> tileSizesH = getTileSizes(H);
+    const std::vector<int> tileSizesW = getTileSizes(W);
+    // Without a limit set by the user, a network instance is executed concurrently per
+    // minInstanceThreads threads of the device, as fewer threads per instance would not be
+    // used efficiently. While profiling, a single instance is used, so the times of the nodes
+    // add up to the execution time of the filter.
+    int maxInstanceCount = (maxParallelTiles > 0) ? maxParallelTiles
+                                                  : max(device->getNumThreads() / minInstanceThreads, 1);
+    if (device->isVerbose(4))
+      maxInstanceCount = 1;
+    double minCost = std::numeric_limits<double>::infinity();
+    size_t minScratchSize = std::numeric_limits<size_t>::max();
+    bool fits = false;
+
+    for (int curTileH : tileSizesH)
+    {
+      for (int curTileW : tileSizesW)
       {
-        tileCountW++;
-        tileW = max(round_up(ceil_div(W - 2*overlap, tileCountW), alignment) + 2*overlap, minTileSize);
+        const int curTileCountH = getTileCount(H, curTileH);
+        const int curTileCountW = getTileCount(W, curTileW);
+        const int tileCount = max(getDenoisedTileCount(curTileH, curTileW, curTileCountH, curTileCountW), 1);
+        const double cost = double(tileCount) * curTileH * curTileW;
+
+        for (int instanceCount = 1; instanceCount <= min(maxInstanceCount, tileCount); ++instanceCount)
+        {
+          const size_t scratchSize = getScratchSize(curTileH, curTileW, curTileCountH, curTileCountW, 1, instanceCount);
+
+          bool better;
+          if (scratchSize <= maxScratchSize)
+          {
+            better = !fits || cost < minCost ||
+                     (cost == minCost && (instanceCount > netInstanceCount ||
+                                          (instanceCount == netInstanceCount && scratchSize < minScratchSize)));
+            fits = true;
+          }
+          else
+            better = !fits && scratchSize < minScratchSize;
+
+          if (better)
+          {
+            tileH = curTileH;
+            tileW = curTileW;
+            tileCountH = curTileCountH;
+            tileCountW = curTileCountW;
+            netInstanceCount = instanceCount;
+            minCost = cost;
+            minScratchSize = scratchSize;
+          }
+
+          // More network instances would not fit either
+          if (scratchSize > maxScratchSize)
+            break;
+        }
       }
-      else
-        break;
     }
 
-    // Compute the final number of tiles
-    tileCountH = (H > tileH) ? ceil_div(H - 2*overlap, tileH - 2*overlap) : 1;
-    tileCountW = (W > tileW) ? ceil_div(W - 2*overlap, tileW - 2*overlap) : 1;
-
-    if (device->isVerbose(2))
+    // Process as many tiles per network execution as the memory limit allows,
+    // spreading the denoised tiles evenly over the executions and network instances
+    const int tileCount = max(getDenoisedTileCount(tileH, tileW, tileCountH, tileCountW), 1);
+    netInstanceCount = min(netInstanceCount, tileCount);
+    netBatchCount = tileCount;
+    netBatchSize = 1;
+  #if defined(OIDN_DNNL)
+    netBatchCount = netInstanceCount;
+    netBatchSize = ceil_div(tileCount, netBatchCount);
+    while (netBatchSize > 1 &&
+           getScratchSize(tileH, tileW, tileCountH, tileCountW, netBatchSize, netInstanceCount) > maxScratchSize)
     {
-      std::cout << "Image size: " << W << "x" << H << std::endl;
-      std::cout << "Tile size : " << tileW << "x" << tileH << std::endl;
-      std::cout << "Tile count: " << tileCountW << "x" << tileCountH << std::endl;
-      std::cout << "In-place  : " << (inplace ? "true" : "false") << std::endl;
+      netBatchCount += netInstanceCount;
+      netBatchSize = ceil_div(tileCount, netBatchCount);
     }
+    netBatchCount = ceil_div(tileCount, netBatchSize);
+    netInstanceCount = min(netInstanceCount, netBatchCount);
+  #endif
   }
 
   void UNetFilter::init()
   {
     // Cleanup
-    net = nullptr;
-    inputReorder = nullptr;
-    outputReorder = nullptr;
-    transferFunc = nullptr;
+    netInstances.clear();
     outputTemp = nullptr;
+    outputRing = nullptr;
+    outputRingRows = 0;
+    scratch = nullptr;
 
     // Check the input/output buffers
     if (!color && !albedo && !normal)
@@ -253,7 +764,10 @@ namespace oidn {
     if (!output)
       throw Exception(Error::InvalidOperation, "output image not specified");
 
-    H = output->height;
+    if (batchSize < 1 || output->height % batchSize != 0)
+      throw Exception(Error::InvalidOperation, "image height is not a multiple of the batch size");
+
+    H = output->height / batchSize; // height of a single batch item
     W = output->width;
 
     if (((color  && color->format  != Format::Float3) ||
@@ -267,11 +781,21 @@ namespace oidn {
     if (output->format != Format::Float3 && output->format != Format::Half3)
       throw Exception(Error::InvalidOperation, "unsupported output image format");
 
-    if ((color  && (color->width  != W || color->height  != H)) ||
-        (albedo && (albedo->width != W || albedo->height != H)) ||
-        (normal && (normal->width != W || normal->height != H)))
+    if ((color  && (color->width  != W || color->height  != output->height)) ||
+        (albedo && (albedo->width != W || albedo->height != output->height)) ||
+        (normal && (normal->width != W || normal->height != output->height)))
       throw Exception(Error::InvalidOperation, "image size mismatch");
 
+    if (mask)
+    {
+      if (!color)
+        throw Exception(Error::InvalidOperation, "mask requires a color image");
+      if (mask->format != Format::Float && mask->format != Format::Half)
+        throw Exception(Error::InvalidOperation, "unsupported mask image format");
+      if (mask->width != W || mask->height != output->height)
+        throw Exception(Error::InvalidOperation, "image size mismatch");
+    }
+
     if (directional && (hdr || srgb))
       throw Exception(Error::InvalidOperation, "directional and hdr/srgb modes cannot be enabled at the same time");
     if (hdr && srgb)
@@ -336,20 +860,107 @@ namespace oidn {
       throw Exception(Error::InvalidOperation, "unsupported combination of input features");
 
     // Parse the weights blob
-    const auto weightsMap = parseTZA(device, weights.ptr, weights.size);
+    weightsMap = parseTZA(device, weights.ptr, weights.size);
+    weightsKey = std::to_string(getHash(weights.ptr, weights.size)) + ":" + std::to_string(weights.size);
 
-    // Create the network
-    net.reset(new Network(device, weightsMap));
+    // Use int8 inference only if the weights have calibrated activation scales
+    quantized = false;
+    if (device->isInt8Enabled())
+    {
+      if (weightsMap.find("input.output_scale") != weightsMap.end())
+        quantized = true;
+      else
+        device->warning("weights are not calibrated for int8, falling back to floating-point");
+    }
 
-    // Compute the tile size
-    computeTileSize();
+    // The tensors of a network instance scale with the area of the tiles, so the scratch size
+    // per tile pixel is computed from the smallest tiles (for which the alignment of the tensors
+    // costs the most), both for a single tile and for a batch of tiles per network execution
+    tileCountH = 1;
+    tileCountW = 1;
+    tileH = 3*overlap;
+    tileW = 3*overlap;
+    netInstanceCount = 1;
+    netBatchSize = 1;
+    tileScratchSize = double(buildNet(true)) / (double(tileH) * tileW);
+    netBatchSize = 2;
+    batchTileScratchSize = double(buildNet(true)) / (2. * tileH * tileW);
+
+    const std::vector<int> maskBlockSums = getMaskBlockSums();
+    size_t tensorScratchSize = 0;
+    size_t nodeScratchSize = 0;
+    for (;;)
+    {
+      // Compute the tile size
+      computeTileSize(maskBlockSums);
 
-    // If the image size is zero, there is nothing else to do
-    if (H <= 0 || W <= 0)
-      return;
+      // If the image size is zero, there is nothing else to do
+      if (H <= 0 || W <= 0)
+      {
+        weightsMap.clear();
+        return;
+      }
+
+      // The tensor scratch size of the chosen tiles was estimated from the scratch size per pixel
+      // of the smallest tiles. If the exact size is larger, recompute the tile size with the
+      // scratch size per pixel of the chosen tiles (which only grows, so this ends).
+      const size_t outputTempSize = getOutputTempSize(tileH, tileCountH, tileCountW, netBatchSize, netInstanceCount);
+      const double pixelScratchSize = double(buildNet(true) - outputTempSize) /
+                                      (double(netInstanceCount) * netBatchSize * tileH * tileW);
+      double& estimatedPixelScratchSize = (netBatchSize > 1) ? batchTileScratchSize : tileScratchSize;
+      if (pixelScratchSize > estimatedPixelScratchSize * 1.001)
+      {
+        estimatedPixelScratchSize = pixelScratchSize;
+        continue;
+      }
 
-    // Build the network
-    buildNet();
+      // Build the network
+      buildNet();
+
+      tensorScratchSize = scratch->size();
+      nodeScratchSize = 0;
+      size_t maxInstanceNodeScratchSize = 0;
+      for (const auto& instance : netInstances)
+      {
+        nodeScratchSize += instance.net->getNodeScratchSize();
+        maxInstanceNodeScratchSize = max(maxInstanceNodeScratchSize, instance.net->getNodeScratchSize());
+      }
+
+      // The node scratch size is known only after building the network, so if it was
+      // underestimated and the memory limit is exceeded, recompute the tile size with it
+      if (maxInstanceNodeScratchSize <= instanceNodeScratchSize ||
+          tensorScratchSize + nodeScratchSize <= size_t(maxMemoryMB)*1024*1024)
+        break;
+
+      instanceNodeScratchSize = maxInstanceNodeScratchSize;
+      netInstances.clear();
+      outputTemp = nullptr;
+      outputRing = nullptr;
+      outputRingRows = 0;
+      scratch = nullptr;
+    }
+
+    // Free the weights
+    weightsMap.clear();
+
+    // Print statistics
+    if (device->isVerbose(2))
+    {
+      std::cout << "Image size: " << W << "x" << H << std::endl;
+      std::cout << "Batch size: " << batchSize << std::endl;
+      std::cout << "Tile size : " << tileW << "x" << tileH << std::endl;
+      std::cout << "Tile count: " << tileCountW << "x" << tileCountH << std::endl;
+      std::cout << "Net batch : " << netBatchSize << " x " << netBatchCount << std::endl;
+      std::cout << "Parallel  : " << netInstanceCount << std::endl;
+      std::cout << "In-place  : " << (inplace ? "true" : "false");
+      if (inplaceAliased && getOutputTempSize(tileH, tileCountH, tileCountW, netBatchSize, netInstanceCount) > 0)
+        std::cout << " (output ring of " << getOutputRingRows(tileCountH, tileCountW, netBatchSize, netInstanceCount) << " tile rows)";
+      std::cout << std::endl;
+      std::cout << "Tile waste: " << (double(tileCountH) * tileCountW * tileH * tileW / (double(H) * W) - 1) * 100 << "%" << std::endl;
+      std::cout << "Tensor scratch bytes: " << tensorScratchSize << std::endl;
+      std::cout << "Node scratch bytes  : " << nodeScratchSize << std::endl;
+      std::cout << "Total scratch bytes : " << tensorScratchSize + nodeScratchSize << std::endl;
+    }
   }
 
   // Builds the network (optional) and returns the size of the scratch memory
@@ -365,8 +976,13 @@ namespace oidn {
     if (albedo) inputC += 3;
     if (normal) inputC += 3;
 
+    // Create the network, which is also used for computing the tensor descriptors
+    std::unique_ptr<Network> net(new Network(device, weightsMap, weightsKey, quantized));
+
     // Compute the tensor descriptors
     TensorDims inputDims = TensorDims({inputC, tileH, tileW});
+    if (netBatchSize > 1)
+      inputDims.insert(inputDims.begin(), netBatchSize); // NCHW
 
     TensorDesc inputReorderDesc = net->getInputReorderDesc(inputDims, alignment);
 
@@ -409,39 +1025,98 @@ namespace oidn {
 
     TensorDesc decConv0Desc  = net->getConvDesc("dec_conv0", decConv1bDesc);
 
+    // A single-item network concatenates the upsampled and skip tensors by
+    // placing them next to each other in memory. With a batch the items would
+    // be interleaved (and in the HWC layout of quantized networks the channels
+    // are interleaved), so the upsampling writes into a separate concatenated
+    // tensor instead and the skip tensor is copied after it.
+    const bool copyConcat = netBatchSize > 1 || quantized;
+    const size_t concat4Size = (copyConcat ? concat4Desc : upsample4Desc).alignedByteSize();
+    const size_t concat3Size = (copyConcat ? concat3Desc : upsample3Desc).alignedByteSize();
+    const size_t concat2Size = (copyConcat ? concat2Desc : upsample2Desc).alignedByteSize();
+    const size_t concat1Size = (copyConcat ? concat1Desc : upsample1Desc).alignedByteSize();
+
+    // The full-resolution outputs of the encoder convolutions followed by pooling
+    // are not stored if the pooling is fused into the convolutions
+    const bool fuseConvPool = net->isConvPoolSupported();
+
+    // The upsampled and concatenated tensors are not stored if the upsampling and
+    // concatenation are fused into the decoder convolutions
+    const bool fuseUpsampleConv = net->isUpsampleConvSupported();
+
     // Compute the tensor offsets
     ptrdiff_t endOfs = 0; // we'll have negative offsets relative to the end of the buffer
     ptrdiff_t inputReorderOfs = endOfs - inputReorderDesc.alignedByteSize();
-    ptrdiff_t encConv0Ofs  = inputReorderOfs - encConv0Desc.alignedByteSize();
-    ptrdiff_t pool1Ofs     = inputReorderOfs - pool1Desc.alignedByteSize();
-    ptrdiff_t encConv1Ofs  = min(encConv0Ofs, pool1Ofs) - encConv1Desc.alignedByteSize();
-    ptrdiff_t pool2Ofs     = pool1Ofs - pool2Desc.alignedByteSize();
-    ptrdiff_t encConv2Ofs  = pool2Ofs - encConv2Desc.alignedByteSize();
-    ptrdiff_t pool3Ofs     = pool2Ofs - pool3Desc.alignedByteSize();
-    ptrdiff_t encConv3Ofs  = pool3Ofs - encConv3Desc.alignedByteSize();
-    ptrdiff_t encConv4Ofs  = pool3Ofs - encConv4Desc.alignedByteSize();
-    ptrdiff_t encConv5aOfs = pool3Ofs - encConv5aDesc.alignedByteSize();
-    ptrdiff_t pool4Ofs     = min(encConv4Ofs, encConv5aOfs) - pool4Desc.alignedByteSize();
-    ptrdiff_t upsample4Ofs = pool3Ofs - upsample4Desc.alignedByteSize();
-    ptrdiff_t encConv5bOfs = min(encConv5aOfs, upsample4Ofs) - encConv5bDesc.alignedByteSize();
-    ptrdiff_t upsample3Ofs = pool2Ofs - upsample3Desc.alignedByteSize();
-    ptrdiff_t decConv4bOfs = upsample3Ofs - decConv4bDesc.alignedByteSize();
-    ptrdiff_t decConv4aOfs = min(upsample4Ofs, decConv4bOfs) - decConv4aDesc.alignedByteSize();
-    ptrdiff_t upsample2Ofs = pool1Ofs - upsample2Desc.alignedByteSize();
-    ptrdiff_t decConv3bOfs = upsample2Ofs - decConv3bDesc.alignedByteSize();
-    ptrdiff_t decConv3aOfs = min(upsample3Ofs, decConv3bOfs) - decConv3aDesc.alignedByteSize();
-    ptrdiff_t upsample1Ofs = inputReorderOfs - upsample1Desc.alignedByteSize();
-    ptrdiff_t decConv2bOfs = upsample1Ofs - decConv2bDesc.alignedByteSize();
-    ptrdiff_t decConv2aOfs = min(upsample2Ofs, decConv2bOfs) - decConv2aDesc.alignedByteSize();
-    ptrdiff_t decConv1bOfs = endOfs - decConv1bDesc.alignedByteSize();
-    ptrdiff_t decConv1aOfs = min(upsample1Ofs, decConv1bOfs) - decConv1aDesc.alignedByteSize();
+    ptrdiff_t encConv0Ofs, encConv1Ofs, encConv2Ofs, encConv3Ofs, encConv4Ofs;
+    ptrdiff_t pool1Ofs, pool2Ofs, pool3Ofs, pool4Ofs, encConv5aOfs;
+    if (fuseConvPool)
+    {
+      pool1Ofs     = inputReorderOfs - pool1Desc.alignedByteSize();
+      encConv0Ofs  = pool1Ofs - encConv0Desc.alignedByteSize();
+      encConv1Ofs  = 0; // not stored
+      pool2Ofs     = pool1Ofs - pool2Desc.alignedByteSize();
+      encConv2Ofs  = 0;
+      pool3Ofs     = pool2Ofs - pool3Desc.alignedByteSize();
+      encConv3Ofs  = 0;
+      pool4Ofs     = pool3Ofs - pool4Desc.alignedByteSize();
+      encConv4Ofs  = 0;
+      encConv5aOfs = pool4Ofs - encConv5aDesc.alignedByteSize();
+    }
+    else
+    {
+      encConv0Ofs  = inputReorderOfs - encConv0Desc.alignedByteSize();
+      pool1Ofs     = inputReorderOfs - pool1Desc.alignedByteSize();
+      encConv1Ofs  = min(encConv0Ofs, pool1Ofs) - encConv1Desc.alignedByteSize();
+      pool2Ofs     = pool1Ofs - pool2Desc.alignedByteSize();
+      encConv2Ofs  = pool2Ofs - encConv2Desc.alignedByteSize();
+      pool3Ofs     = pool2Ofs - pool3Desc.alignedByteSize();
+      encConv3Ofs  = pool3Ofs - encConv3Desc.alignedByteSize();
+      encConv4Ofs  = pool3Ofs - encConv4Desc.alignedByteSize();
+      encConv5aOfs = pool3Ofs - encConv5aDesc.alignedByteSize();
+      pool4Ofs     = min(encConv4Ofs, encConv5aOfs) - pool4Desc.alignedByteSize();
+    }
+    ptrdiff_t concat4Ofs, concat3Ofs, concat2Ofs, concat1Ofs;
+    ptrdiff_t encConv5bOfs, decConv4aOfs, decConv4bOfs, decConv3aOfs, decConv3bOfs;
+    ptrdiff_t decConv2aOfs, decConv2bOfs, decConv1aOfs, decConv1bOfs;
+    if (fuseUpsampleConv)
+    {
+      // The decoder convolutions read the low-resolution tensors and the skip tensors directly
+      concat4Ofs = concat3Ofs = concat2Ofs = concat1Ofs = 0; // not stored
+      encConv5bOfs = encConv5aOfs - encConv5bDesc.alignedByteSize();
+      decConv4bOfs = pool2Ofs - decConv4bDesc.alignedByteSize();
+      decConv4aOfs = min(encConv5bOfs, decConv4bOfs) - decConv4aDesc.alignedByteSize();
+      decConv3bOfs = pool1Ofs - decConv3bDesc.alignedByteSize();
+      decConv3aOfs = min(decConv4bOfs, decConv3bOfs) - decConv3aDesc.alignedByteSize();
+      decConv2bOfs = inputReorderOfs - decConv2bDesc.alignedByteSize();
+      decConv2aOfs = min(decConv3bOfs, decConv2bOfs) - decConv2aDesc.alignedByteSize();
+      decConv1bOfs = endOfs - decConv1bDesc.alignedByteSize();
+      decConv1aOfs = min(decConv2bOfs, decConv1bOfs) - decConv1aDesc.alignedByteSize();
+    }
+    else
+    {
+      concat4Ofs   = pool3Ofs - concat4Size;
+      encConv5bOfs = min(encConv5aOfs, concat4Ofs) - encConv5bDesc.alignedByteSize();
+      concat3Ofs   = pool2Ofs - concat3Size;
+      decConv4bOfs = concat3Ofs - decConv4bDesc.alignedByteSize();
+      decConv4aOfs = min(concat4Ofs, decConv4bOfs) - decConv4aDesc.alignedByteSize();
+      concat2Ofs   = pool1Ofs - concat2Size;
+      decConv3bOfs = concat2Ofs - decConv3bDesc.alignedByteSize();
+      decConv3aOfs = min(concat3Ofs, decConv3bOfs) - decConv3aDesc.alignedByteSize();
+      concat1Ofs   = inputReorderOfs - concat1Size;
+      decConv2bOfs = concat1Ofs - decConv2bDesc.alignedByteSize();
+      decConv2aOfs = min(concat2Ofs, decConv2bOfs) - decConv2aDesc.alignedByteSize();
+      decConv1bOfs = endOfs - decConv1bDesc.alignedByteSize();
+      decConv1aOfs = min(concat1Ofs, decConv1bOfs) - decConv1aDesc.alignedByteSize();
+    }
     ptrdiff_t decConv0Ofs  = decConv1bOfs - decConv0Desc.alignedByteSize();
 
     const std::vector<ptrdiff_t> minOfsList = {
+      encConv0Ofs,
       encConv1Ofs,
       encConv2Ofs,
       encConv3Ofs,
       pool4Ofs,
+      encConv5aOfs,
       encConv5bOfs,
       decConv4aOfs,
       decConv3aOfs,
@@ -449,14 +1124,19 @@ namespace oidn {
       decConv1aOfs,
       decConv0Ofs
     };
-    ptrdiff_t minOfs = *std::min_element(minOfsList.begin(), minOfsList.end());
+
+    // Each network instance has its own copy of the tensors
+    const size_t instanceScratchSize = -*std::min_element(minOfsList.begin(), minOfsList.end());
+    ptrdiff_t minOfs = -ptrdiff_t(netInstanceCount * instanceScratchSize);
 
     // If doing in-place _tiled_ filtering, we need a temporary output buffer too
-    ImageDesc outputTempDesc(output->format, W, H);
+    // (unless all tiles are denoised by a single network execution)
+    const size_t outputTempSize = getOutputTempSize(tileH, tileCountH, tileCountW, netBatchSize, netInstanceCount);
+    const int ringRows = inplaceAliased ? getOutputRingRows(tileCountH, tileCountW, netBatchSize, netInstanceCount) : 0;
     ptrdiff_t outputTempOfs = 0;
-    if (inplace && (tileCountH * tileCountW) > 1)
+    if (outputTempSize > 0)
     {
-      outputTempOfs = minOfs - outputTempDesc.alignedByteSize();
+      outputTempOfs = minOfs - outputTempSize;
       minOfs = outputTempOfs;
     }
 
@@ -466,125 +1146,155 @@ namespace oidn {
       return scratchSize;
 
     // Allocate the scratch buffer
-    net->allocScratch(scratchSize);
+    scratch = device->newScratchBuffer(scratchSize);
 
-    // Create the transfer function
-    transferFunc = getTransferFunc();
+    // Create the temporary output
+    if (outputTempOfs && inplaceAliased)
+    {
+      outputRingRows = ringRows;
+      outputRing = scratch->newImage(ImageDesc(output->format, W, ringRows * tileH), outputTempOfs);
+    }
+    else if (outputTempOfs)
+      outputTemp = scratch->newImage(ImageDesc(output->format, W, output->height), outputTempOfs);
 
-    // Create the nodes
-    const bool snorm = directional || (!color && normal);
+    // Build the network instances
+    netInstances.resize(netInstanceCount);
+    for (int p = 0; p < netInstanceCount; ++p)
+    {
+      NetInstance& instance = netInstances[p];
+      if (p > 0)
+        net.reset(new Network(device, weightsMap, weightsKey, quantized));
+      net->setScratch(scratch, -ptrdiff_t(p * instanceScratchSize));
 
-    inputReorder = net->addInputReorder("input",
-                                        net->newTensor(inputReorderDesc, inputReorderOfs),
-                                        transferFunc, hdr, snorm);
+      // Returns a view of the k-th batch item of a tensor in the scratch buffer
+      auto newItemTensor = [&](const TensorDesc& desc, ptrdiff_t ofs, int k)
+      {
+        const TensorDesc itemDesc = desc.itemDesc();
+        return net->newTensor(itemDesc, ofs + k * ptrdiff_t(itemDesc.byteSize()));
+      };
 
-    auto encConv0 = net->addConv("enc_conv0",
-                                 inputReorder->getDst(),
-                                 net->newTensor(encConv0Desc, encConv0Ofs));
+      // Create the nodes
+      const bool snorm = directional || (!color && normal);
 
-    auto encConv1 = net->addConv("enc_conv1",
-                                 encConv0->getDst(),
-                                 net->newTensor(encConv1Desc, encConv1Ofs));
+      // Each batch item has its own input/output and transfer function
+      for (int k = 0; k < netBatchSize; ++k)
+      {
+        instance.transferFuncs.push_back(getTransferFunc());
+        instance.inputReorders.push_back(net->addInputReorder("input",
+                                                              newItemTensor(inputReorderDesc, inputReorderOfs, k),
+                                                              instance.transferFuncs[k], hdr, snorm));
+      }
 
-    auto pool1 = net->addPool("pool1",
-                              encConv1->getDst(),
-                              net->newTensor(pool1Desc, pool1Ofs));
+      auto input = net->newTensor(inputReorderDesc, inputReorderOfs);
 
-    auto encConv2 = net->addConv("enc_conv2",
-                                 pool1->getDst(),
-                                 net->newTensor(encConv2Desc, encConv2Ofs));
+      auto encConv0 = net->addConv("enc_conv0",
+                                   input,
+                                   net->newTensor(encConv0Desc, encConv0Ofs));
 
-    auto pool2 = net->addPool("pool2",
-                              encConv2->getDst(),
-                              net->newTensor(pool2Desc, pool2Ofs));
+      // Adds an encoder convolution followed by pooling
+      auto addConvPool = [&](const std::string& convName, const std::string& poolName,
+                             const std::shared_ptr<Tensor>& src,
+                             const TensorDesc& convDesc, ptrdiff_t convOfs,
+                             const TensorDesc& poolDesc, ptrdiff_t poolOfs)
+      {
+        if (fuseConvPool)
+          return net->addConvPool(convName, src, net->newTensor(poolDesc, poolOfs));
 
-    auto encConv3 = net->addConv("enc_conv3",
-                                 pool2->getDst(),
-                                 net->newTensor(encConv3Desc, encConv3Ofs));
+        auto conv = net->addConv(convName, src, net->newTensor(convDesc, convOfs));
+        return net->addPool(poolName, conv->getDst(), net->newTensor(poolDesc, poolOfs));
+      };
 
-    auto pool3 = net->addPool("pool3",
-                              encConv3->getDst(),
-                              net->newTensor(pool3Desc, pool3Ofs));
+      auto pool1 = addConvPool("enc_conv1", "pool1", encConv0->getDst(),
+                               encConv1Desc, encConv1Ofs, pool1Desc, pool1Ofs);
 
-    auto encConv4 = net->addConv("enc_conv4",
-                                 pool3->getDst(),
-                                 net->newTensor(encConv4Desc, encConv4Ofs));
+      auto pool2 = addConvPool("enc_conv2", "pool2", pool1->getDst(),
+                               encConv2Desc, encConv2Ofs, pool2Desc, pool2Ofs);
 
-    auto pool4 = net->addPool("pool4",
-                              encConv4->getDst(),
-                              net->newTensor(pool4Desc, pool4Ofs));
+      auto pool3 = addConvPool("enc_conv3", "pool3", pool2->getDst(),
+                               encConv3Desc, encConv3Ofs, pool3Desc, pool3Ofs);
 
-    auto encConv5a = net->addConv("enc_conv5a",
-                                  pool4->getDst(),
-                                  net->newTensor(encConv5aDesc, encConv5aOfs));
+      auto pool4 = addConvPool("enc_conv4", "pool4", pool3->getDst(),
+                               encConv4Desc, encConv4Ofs, pool4Desc, pool4Ofs);
 
-    auto encConv5b = net->addConv("enc_conv5b",
-                                  encConv5a->getDst(),
-                                  net->newTensor(encConv5bDesc, encConv5bOfs));
+      auto encConv5a = net->addConv("enc_conv5a",
+                                    pool4->getDst(),
+                                    net->newTensor(encConv5aDesc, encConv5aOfs));
 
-    auto upsample4 = net->addUpsample("upsample4",
-                                      encConv5b->getDst(),
-                                      net->newTensor(upsample4Desc, upsample4Ofs));
+      auto encConv5b = net->addConv("enc_conv5b",
+                                    encConv5a->getDst(),
+                                    net->newTensor(encConv5bDesc, encConv5bOfs));
 
-    auto decConv4a = net->addConv("dec_conv4a",
-                                  net->newTensor(concat4Desc, upsample4Ofs),
-                                  net->newTensor(decConv4aDesc, decConv4aOfs));
+      // Adds a decoder convolution of the upsampled source concatenated with the skip tensor
+      auto addUpsampleConv = [&](const std::string& upsampleName, const std::string& concatName,
+                                 const std::string& convName,
+                                 const std::shared_ptr<Tensor>& src, const std::shared_ptr<Tensor>& skip,
+                                 const TensorDesc& upsampleDesc,
+                                 const TensorDesc& concatDesc, ptrdiff_t concatOfs,
+                                 const TensorDesc& convDesc, ptrdiff_t convOfs)
+      {
+        if (fuseUpsampleConv)
+          return net->addUpsampleConv(convName, src, skip, net->newTensor(convDesc, convOfs));
 
-    auto decConv4b = net->addConv("dec_conv4b",
-                                  decConv4a->getDst(),
-                                  net->newTensor(decConv4bDesc, decConv4bOfs));
+        auto concat = net->newTensor(concatDesc, concatOfs);
 
-    auto upsample3 = net->addUpsample("upsample3",
-                                      decConv4b->getDst(),
-                                      net->newTensor(upsample3Desc, upsample3Ofs));
+        net->addUpsample(upsampleName,
+                         src,
+                         copyConcat ? concat : net->newTensor(upsampleDesc, concatOfs));
 
-    auto decConv3a = net->addConv("dec_conv3a",
-                                  net->newTensor(concat3Desc, upsample3Ofs),
-                                  net->newTensor(decConv3aDesc, decConv3aOfs));
+        if (copyConcat)
+          net->addConcat(concatName, skip, concat, upsampleDesc.numChannels());
 
-    auto decConv3b = net->addConv("dec_conv3b",
-                                  decConv3a->getDst(),
-                                  net->newTensor(decConv3bDesc, decConv3bOfs));
+        return net->addConv(convName, concat, net->newTensor(convDesc, convOfs));
+      };
 
-    auto upsample2 = net->addUpsample("upsample2",
-                                      decConv3b->getDst(),
-                                      net->newTensor(upsample2Desc, upsample2Ofs));
+      auto decConv4a = addUpsampleConv("upsample4", "concat4", "dec_conv4a",
+                                       encConv5b->getDst(), pool3->getDst(), upsample4Desc,
+                                       concat4Desc, concat4Ofs, decConv4aDesc, decConv4aOfs);
 
-    auto decConv2a = net->addConv("dec_conv2a",
-                                  net->newTensor(concat2Desc, upsample2Ofs),
-                                  net->newTensor(decConv2aDesc, decConv2aOfs));
+      auto decConv4b = net->addConv("dec_conv4b",
+                                    decConv4a->getDst(),
+                                    net->newTensor(decConv4bDesc, decConv4bOfs));
 
-    auto decConv2b = net->addConv("dec_conv2b",
-                                  decConv2a->getDst(),
-                                  net->newTensor(decConv2bDesc, decConv2bOfs));
+      auto decConv3a = addUpsampleConv("upsample3", "concat3", "dec_conv3a",
+                                       decConv4b->getDst(), pool2->getDst(), upsample3Desc,
+                                       concat3Desc, concat3Ofs, decConv3aDesc, decConv3aOfs);
 
-    auto upsample1 = net->addUpsample("upsample1",
-                                      decConv2b->getDst(),
-                                      net->newTensor(upsample1Desc, upsample1Ofs));
+      auto decConv3b = net->addConv("dec_conv3b",
+                                    decConv3a->getDst(),
+                                    net->newTensor(decConv3bDesc, decConv3bOfs));
 
-    auto decConv1a = net->addConv("dec_conv1a",
-                                  net->newTensor(concat1Desc, upsample1Ofs),
-                                  net->newTensor(decConv1aDesc, decConv1aOfs));
+      auto decConv2a = addUpsampleConv("upsample2", "concat2", "dec_conv2a",
+                                       decConv3b->getDst(), pool1->getDst(), upsample2Desc,
+                                       concat2Desc, concat2Ofs, decConv2aDesc, decConv2aOfs);
 
-    auto decConv1b = net->addConv("dec_conv1b",
-                                  decConv1a->getDst(),
-                                  net->newTensor(decConv1bDesc, decConv1bOfs));
+      auto decConv2b = net->addConv("dec_conv2b",
+                                    decConv2a->getDst(),
+                                    net->newTensor(decConv2bDesc, decConv2bOfs));
 
-    auto decConv0 = net->addConv("dec_conv0",
-                                 decConv1b->getDst(),
-                                 net->newTensor(decConv0Desc, decConv0Ofs),
-                                 false);
+      auto decConv1a = addUpsampleConv("upsample1", "concat1", "dec_conv1a",
+                                       decConv2b->getDst(), input, upsample1Desc,
+                                       concat1Desc, concat1Ofs, decConv1aDesc, decConv1aOfs);
 
-    outputReorder = net->addOutputReorder("output",
-                                          decConv0->getDst(),
-                                          transferFunc, hdr, snorm);
+      auto decConv1b = net->addConv("dec_conv1b",
+                                    decConv1a->getDst(),
+                                    net->newTensor(decConv1bDesc, decConv1bOfs));
 
-    // Create the temporary output
-    if (outputTempOfs)
-      outputTemp = net->newImage(outputTempDesc, outputTempOfs);
+      net->addConv("dec_conv0",
+                   decConv1b->getDst(),
+                   net->newTensor(decConv0Desc, decConv0Ofs),
+                   false);
+
+      for (int k = 0; k < netBatchSize; ++k)
+      {
+        instance.outputReorders.push_back(net->addOutputReorder("output",
+                                                                newItemTensor(decConv0Desc, decConv0Ofs, k),
+                                                                instance.transferFuncs[k], hdr, snorm));
+      }
 
-    // Finalize the network
-    net->finalize();
+      // Finalize the network
+      net->finalize();
+      instance.net = std::move(net);
+    }
 
     return scratchSize;
   }
@@ -662,6 +1372,10 @@ namespace oidn {
       setParam(cleanAux, value);
     else if (name == "maxMemoryMB")
       setParam(maxMemoryMB, value);
+    else if (name == "batchSize")
+      setParam(batchSize, value);
+    else if (name == "maxParallelTiles")
+      setParam(maxParallelTiles, value);
     else
       device->warning("unknown filter parameter");
 
@@ -678,6 +1392,10 @@ namespace oidn {
       return cleanAux;
     else if (name == "maxMemoryMB")
       return maxMemoryMB;
+    else if (name == "batchSize")
+      return batchSize;
+    else if (name == "maxParallelTiles")
+      return maxParallelTiles;
     else if (name == "alignment")
       return alignment;
     else if (name == "overlap")
@@ -715,6 +1433,8 @@ namespace oidn {
       setParam(color, image);
     else if (name == "output")
       setParam(output, image);
+    else if (name == "mask")
+      setParam(mask, image);
     else
       device->warning("unknown filter parameter");
 
@@ -727,6 +1447,8 @@ namespace oidn {
       removeParam(color);
     else if (name == "output")
       removeParam(output);
+    else if (name == "mask")
+      removeParam(mask);
     else
       device->warning("unknown filter parameter");
 
@@ -742,6 +1464,10 @@ namespace oidn {
     }
     else if (name == "maxMemoryMB")
       setParam(maxMemoryMB, value);
+    else if (name == "batchSize")
+      setParam(batchSize, value);
+    else if (name == "maxParallelTiles")
+      setParam(maxParallelTiles, value);
     else
       device->warning("unknown filter parameter");
 
@@ -754,6 +1480,10 @@ namespace oidn {
       return directional;
     else if (name == "maxMemoryMB")
       return maxMemoryMB;
+    else if (name == "batchSize")
+      return batchSize;
+    else if (name == "maxParallelTiles")
+      return maxParallelTiles;
     else if (name == "alignment")
       return alignment;
     else if (name == "overlap")
@@ -21,6 +21,9 @@ namespace oidn {
     static constexpr int alignment       = 16;  // required spatial alignment in pixels (padding may be necessary)
     static constexpr int receptiveField  = 174; // receptive field in pixels
     static constexpr int overlap         = round_up(receptiveField / 2, alignment); // required spatial overlap between tiles in pixels
+    static constexpr int minInstanceThreads = 8; // minimum number of device threads per concurrently executing network instance
+    static constexpr int maskBlockSize   = 16;  // size of the blocks in which the occupancy of the mask is tracked
+    static constexpr double minRetileGain = 0.25; // relative reduction of the computed pixels for which a new mask changes the tiling
 
     // Images
     std::shared_ptr<Image> color;
@@ -28,6 +31,8 @@ namespace oidn {
     std::shared_ptr<Image> normal;
     std::shared_ptr<Image> output;
     std::shared_ptr<Image> outputTemp; // required for in-place tiled filtering
+    std::shared_ptr<Image> outputRing; // replaces outputTemp if the output aliases the input
+    std::shared_ptr<Image> mask;       // optional, tiles without positive mask values are copied instead of denoised
 
     // Options
     bool hdr = false;
@@ -36,21 +41,61 @@ namespace oidn {
     float inputScale = std::numeric_limits<float>::quiet_NaN();
     bool cleanAux = false;
     int maxMemoryMB = 3000; // approximate maximum memory usage in MBs
+    int batchSize = 1;      // number of same-sized images stacked vertically in the input/output images
+    int maxParallelTiles = 0; // maximum number of tiles denoised concurrently (0: from the number of device threads)
 
     // Image dimensions
-    int H = 0;            // image height
+    int H = 0;            // image height (of one batch item)
     int W = 0;            // image width
     int tileH = 0;        // tile height
     int tileW = 0;        // tile width
     int tileCountH = 1;   // number of tiles in H dimension
     int tileCountW = 1;   // number of tiles in W dimension
     bool inplace = false; // indicates whether input and output buffers overlap
+    bool inplaceAliased = false; // indicates whether the overlapping input images are the output image itself
+    int outputRingRows = 0; // number of tile rows in the output ring
+    int netBatchSize = 1; // number of tiles denoised by one network execution
+    int netBatchCount = 1; // number of network executions per filter execution
+    int netInstanceCount = 1; // number of network instances executing concurrently
+    size_t instanceNodeScratchSize = 0; // node scratch size of a network instance, measured when built
+    double tileScratchSize = 0;      // tensor scratch size per tile pixel with single tile executions
+    double batchTileScratchSize = 0; // tensor scratch size per tile pixel with batched executions
+    bool quantized = false; // int8 inference with the calibrated scales of the weights
+
+    // Tile of a batch item
+    struct Tile
+    {
+      int n;                            // batch item
+      int h, w;                         // input origin
+      int H1, W1;                       // input size
+      int H2, W2;                       // output size (without the overlaps)
+      int overlapBeginH, overlapBeginW; // overlap before the output
+      int alignOffsetH, alignOffsetW;   // offset of the input in the network tile
+    };
+
+    // Time of a network execution (profiling)
+    struct TileTime
+    {
+      int tile;      // first tile
+      int tileCount; // number of tiles
+      double time;
+    };
+
+    // Network instance with its own region of the scratch buffer
+    struct NetInstance
+    {
+      std::unique_ptr<Network> net;
+      std::vector<std::shared_ptr<InputReorderNode>> inputReorders;   // one per network batch item
+      std::vector<std::shared_ptr<OutputReorderNode>> outputReorders; // one per network batch item
+      std::vector<std::shared_ptr<TransferFunction>> transferFuncs;   // one per network batch item
+      std::vector<TileTime> tileTimes;
+    };
 
     // Network
-    std::unique_ptr<Network> net;
-    std::shared_ptr<InputReorderNode> inputReorder;
-    std::shared_ptr<OutputReorderNode> outputReorder;
-    std::shared_ptr<TransferFunction> transferFunc;
+    std::map<std::string, std::shared_ptr<Tensor>> weightsMap;
+    std::string weightsKey; // identifies the weights in the weights cache of the device
+    std::vector<NetInstance> netInstances;
+    Ref<ScratchBuffer> scratch; // shared by all network instances
 
     // Weights
     struct
@@ -84,8 +129,17 @@ namespace oidn {
 
   private:
     void init();
-    void computeTileSize();
+    std::vector<int> getMaskBlockSums();
+    int getDenoisedTileCount(const std::vector<int>& maskBlockSums,
+                             int tileH, int tileW, int tileCountH, int tileCountW) const;
+    double getTilingCost(const std::vector<int>& maskBlockSums) const;
+    void computeTileSize(const std::vector<int>& maskBlockSums);
+    std::shared_ptr<Image> getBatchItem(const std::shared_ptr<Image>& image, int n);
+    Tile getTile(int tileIndex) const;
+    int getOutputRingRows(int tileCountH, int tileCountW, int netBatchSize, int netInstanceCount) const;
+    size_t getOutputTempSize(int tileH, int tileCountH, int tileCountW, int netBatchSize, int netInstanceCount) const;
     size_t buildNet(bool getScratchSizeOnly = false);
+    void printProfile(double totalTime);
   };
 
   // ---------------------------------------------------------------------------
@@ -15,21 +15,65 @@ namespace oidn {
     : UpsampleNode(device, name, src, dst)
   {
     assert(src->layout == TensorLayout::Chw8c ||
-           src->layout == TensorLayout::Chw16c);
-    assert(src->blockSize() == device->getTensorBlockSize());
+           src->layout == TensorLayout::Chw16c ||
+           src->layout == TensorLayout::hwc);
+    assert(src->layout == TensorLayout::hwc || src->blockSize() == device->getTensorBlockSize());
+    assert(dst->dataType == src->dataType && dst->scale == src->scale);
   }
 
   void CPUUpsampleNode::execute()
   {
+    if (src->layout == TensorLayout::hwc)
+    {
+      executeHWC();
+      return;
+    }
+
     const int K = device->getTensorBlockSize();
 
-    ispc::Upsample impl;
-    impl.src = *src;
-    impl.dst = *dst;
+    const int N = src->batchSize();
+
+    std::vector<ispc::Upsample> impls(N);
+    for (int n = 0; n < N; ++n)
+    {
+      impls[n].src = src->getItemAccessor(n);
+      impls[n].dst = dst->getItemAccessor(n);
+    }
+
+    parallel_nd(N, src->numChannels() / K, src->height(), [&](int n, int ck, int h)
+    {
+      ispc::Upsample_kernel(&impls[n], ck, h);
+    });
+  }
+
+  // The channels of a pixel are contiguous, so each source pixel is copied to
+  // the leading channels of the 2x2 destination pixels
+  void CPUUpsampleNode::executeHWC()
+  {
+    const size_t H = src->height();
+    const size_t W = src->width();
+    const size_t srcPixelByteSize = src->numChannels() * src->elementByteSize();
+    const size_t dstPixelByteSize = dst->numChannels() * dst->elementByteSize();
+    const size_t srcItemByteSize = src->byteSize() / src->batchSize();
+    const size_t dstItemByteSize = dst->byteSize() / dst->batchSize();
+
+    const char* srcPtr = (const char*)src->data();
+    char* dstPtr = (char*)dst->data();
 
-    parallel_nd(impl.src.C / K, impl.src.H, [&](int ck, int h)
+    parallel_nd(src->batchSize(), int(H), [&](int n, int h)
     {
-      ispc::Upsample_kernel(&impl, ck, h);
+      const char* srcPtr_line = srcPtr + n * srcItemByteSize + h * W * srcPixelByteSize;
+      char* dstPtr_line0 = dstPtr + n * dstItemByteSize + (h*2) * (W*2) * dstPixelByteSize;
+      char* dstPtr_line1 = dstPtr_line0 + (W*2) * dstPixelByteSize; // next line
+
+      for (size_t w = 0; w < W; ++w)
+      {
+        const char* value = srcPtr_line + w * srcPixelByteSize;
+        memcpy(dstPtr_line0 + (w*2)   * dstPixelByteSize, value, srcPixelByteSize);
+        memcpy(dstPtr_line0 + (w*2+1) * dstPixelByteSize, value, srcPixelByteSize);
+        memcpy(dstPtr_line1 + (w*2)   * dstPixelByteSize, value, srcPixelByteSize);
+        memcpy(dstPtr_line1 + (w*2+1) * dstPixelByteSize, value, srcPixelByteSize);
+      }
     });
   }
 
@@ -46,6 +90,8 @@ namespace oidn {
 
   void CPUUpsampleNode::execute()
   {
+    assert(src->ndims() == 3 && dst->numChannels() == src->numChannels());
+
     const size_t C = src->dims[0];
     const size_t H = src->dims[1];
     const size_t W = src->dims[2];
@@ -7,7 +7,9 @@
 
 namespace oidn {
 
-  // 2x2 nearest-neighbor upsampling node (blocked layout)
+  // 2x2 nearest-neighbor upsampling node (blocked or HWC layout)
+  // The destination may have more channels than the source, in which case only
+  // the leading channels of each batch item are written (e.g. concatenated tensor)
   class UpsampleNode : public Node
   {
   protected:
@@ -23,15 +25,17 @@ namespace oidn {
         src(src),
         dst(dst)
     {
-      assert(src->ndims() == 3);
-      assert(dst->ndims() == 3);
+      assert(src->ndims() == 3 || src->ndims() == 4);
+      assert(dst->ndims() == src->ndims());
       assert(dst->layout == src->layout);
-      assert(dst->dims[0] == src->dims[0]);     // C
-      assert(dst->dims[1] == src->dims[1] * 2); // H
-      assert(dst->dims[2] == src->dims[2] * 2); // W
+      assert(dst->batchSize() == src->batchSize());     // N
+      assert(dst->numChannels() >= src->numChannels()); // C
+      assert(dst->height() == src->height() * 2);       // H
+      assert(dst->width()  == src->width()  * 2);       // W
     }
 
     std::shared_ptr<Tensor> getDst() const override { return dst; }
+    double getByteCount() const override { return 5. * src->byteSize(); } // the source is written 4 times
   };
 
   class CPUUpsampleNode : public UpsampleNode
@@ -43,6 +47,11 @@ namespace oidn {
                     const std::shared_ptr<Tensor>& dst);
 
     void execute() override;
+
+  private:
+  #if defined(OIDN_DNNL)
+    void executeHWC();
+  #endif
   };
 
 } // namespace oidn
@@ -47,7 +47,8 @@ OIDN_API OIDNDevice oidnNewDevice(OIDNDeviceType type);
 // Retains the device (increments the reference count).
 OIDN_API void oidnRetainDevice(OIDNDevice device);
 
-// Releases the device (decrements the reference count).
+// Releases the device (decrements the reference count). Waits until the pending
+// asynchronous filter executions of the device have completed.
 OIDN_API void oidnReleaseDevice(OIDNDevice device);
 
 // Sets a boolean parameter of the device.
@@ -211,4 +212,25 @@ OIDN_API void oidnCommitFilter(OIDNFilter filter);
 // Executes the filter.
 OIDN_API void oidnExecuteFilter(OIDNFilter filter);
 
+// Completion callback function of asynchronous filter executions
+typedef void (*OIDNCompletionFunction)(void* userPtr, OIDNError code, const char* message);
+
+// Sets the completion callback function of the filter, which is called from the
+// thread of the device which ran an asynchronous execution when it has
+// completed. The callback may call functions on the filter, other threads
+// waiting for the filter are blocked until it returns.
+OIDN_API void oidnSetFilterCompletionFunction(OIDNFilter filter, OIDNCompletionFunction func, void* userPtr);
+
+// Starts executing the filter asynchronously and returns immediately.
+// Other calls on the filter wait until the execution has completed.
+OIDN_API void oidnExecuteFilterAsync(OIDNFilter filter);
+
+// Waits until the asynchronous execution of the filter has completed, and
+// reports its error (if any) as the error of the device.
+OIDN_API void oidnWaitFilter(OIDNFilter filter);
+
+// Returns whether the asynchronous execution of the filter has completed,
+// without waiting.
+OIDN_API bool oidnPollFilter(OIDNFilter filter);
+
 OIDN_API_NAMESPACE_END
@@ -139,6 +139,10 @@ OIDN_NAMESPACE_BEGIN
   // Progress monitor callback function
   typedef bool (*ProgressMonitorFunction)(void* userPtr, double n);
 
+  // Completion callback function of asynchronous filter executions
+  enum class Error;
+  typedef void (*CompletionFunction)(void* userPtr, Error code, const char* message);
+
   // Filter object with automatic reference counting
   class FilterRef
   {
@@ -298,6 +302,30 @@ OIDN_NAMESPACE_BEGIN
     {
       oidnExecuteFilter(handle);
     }
+
+    // Sets the completion callback function of the asynchronous executions of the filter.
+    void setCompletionFunction(CompletionFunction func, void* userPtr = nullptr)
+    {
+      oidnSetFilterCompletionFunction(handle, (OIDNCompletionFunction)func, userPtr);
+    }
+
+    // Starts executing the filter asynchronously.
+    void executeAsync()
+    {
+      oidnExecuteFilterAsync(handle);
+    }
+
+    // Waits until the asynchronous execution of the filter has completed.
+    void wait()
+    {
+      oidnWaitFilter(handle);
+    }
+
+    // Returns whether the asynchronous execution of the filter has completed.
+    bool poll()
+    {
+      return oidnPollFilter(handle);
+    }
   };
 
   // Gets a boolean parameter of the filter.
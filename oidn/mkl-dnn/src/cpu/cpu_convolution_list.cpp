@@ -38,16 +38,16 @@
 #include "cpu/x64/jit_avx2_convolution.hpp"
 //#include "cpu/x64/jit_avx512_common_1x1_convolution.hpp"
 #include "cpu/x64/jit_avx512_common_convolution.hpp"
-//#include "cpu/x64/jit_avx512_common_convolution_winograd.hpp"
+#include "cpu/x64/jit_avx512_common_convolution_winograd.hpp"
 //#include "cpu/x64/jit_avx512_core_amx_1x1_convolution.hpp"
 //#include "cpu/x64/jit_avx512_core_amx_convolution.hpp"
 //#include "cpu/x64/jit_avx512_core_bf16_1x1_convolution.hpp"
-//#include "cpu/x64/jit_avx512_core_bf16_convolution.hpp"
+#include "cpu/x64/jit_avx512_core_bf16_convolution.hpp"
 //#include "cpu/x64/jit_avx512_core_f32_wino_conv_2x3.hpp"
-//#include "cpu/x64/jit_avx512_core_f32_wino_conv_4x3.hpp"
+#include "cpu/x64/jit_avx512_core_f32_wino_conv_4x3.hpp"
 //#include "cpu/x64/jit_avx512_core_u8s8s32x_wino_convolution.hpp"
 //#include "cpu/x64/jit_avx512_core_x8s8s32x_1x1_convolution.hpp"
-//#include "cpu/x64/jit_avx512_core_x8s8s32x_convolution.hpp"
+#include "cpu/x64/jit_avx512_core_x8s8s32x_convolution.hpp"
 //#include "cpu/x64/jit_brgemm_1x1_conv.hpp"
 //#include "cpu/x64/jit_brgemm_conv.hpp"
 //#include "cpu/x64/jit_sse41_1x1_convolution.hpp"
@@ -106,8 +106,8 @@ const std::map<conv_impl_key_t, std::vector<pd_create_f>> impl_list_map {
         //CPU_INSTANCE_X64(jit_avx512_common_dw_convolution_fwd_t)
         //CPU_INSTANCE_X64(jit_avx512_common_1x1_convolution_fwd_f32_t)
         //CPU_INSTANCE_X64(jit_avx512_core_f32_wino_conv_2x3_fwd_t)
-        //CPU_INSTANCE_X64(jit_avx512_core_f32_wino_conv_4x3_fwd_t)
-        //CPU_INSTANCE_X64(jit_avx512_common_convolution_winograd_fwd_t)
+        CPU_INSTANCE_X64(jit_avx512_core_f32_wino_conv_4x3_fwd_t)
+        CPU_INSTANCE_X64(jit_avx512_common_convolution_winograd_fwd_t)
         CPU_INSTANCE_X64(jit_avx512_common_convolution_fwd_t<f32>)
         //CPU_INSTANCE_AARCH64_ACL(acl_wino_convolution_fwd_t)
         //CPU_INSTANCE_X64(jit_avx2_dw_convolution_fwd_t)
@@ -125,32 +125,70 @@ const std::map<conv_impl_key_t, std::vector<pd_create_f>> impl_list_map {
         //CPU_INSTANCE(ref_fused_convolution_fwd_t)
         nullptr,
     }},
-    /*
-    {{forward, bf16, bf16, f32}, {
-        CPU_INSTANCE_X64(jit_avx512_core_amx_1x1_convolution_fwd_t<bf16, bf16, f32>)
-        CPU_INSTANCE_X64(jit_avx512_core_amx_convolution_fwd_t<bf16, bf16, f32>)
-        CPU_INSTANCE_X64(brgemm_1x1_convolution_fwd_t<avx512_core_bf16, bf16, bf16, f32>)
-        CPU_INSTANCE_X64(brgemm_convolution_fwd_t<avx512_core_bf16, bf16, bf16, f32>)
-        CPU_INSTANCE_X64(jit_uni_dw_convolution_fwd_t<avx512_core, bf16, f32>)
-        CPU_INSTANCE_X64(jit_avx512_core_bf16_1x1_convolution_fwd_t<f32>)
+    {{forward, bf16, bf16, bf16}, {
+        //CPU_INSTANCE_X64(jit_avx512_core_amx_1x1_convolution_fwd_t<bf16, bf16, bf16>)
+        //CPU_INSTANCE_X64(jit_avx512_core_amx_convolution_fwd_t<bf16, bf16, bf16>)
+        //CPU_INSTANCE_X64(brgemm_1x1_convolution_fwd_t<avx512_core_bf16, bf16, bf16, bf16>)
+        //CPU_INSTANCE_X64(brgemm_convolution_fwd_t<avx512_core_bf16, bf16, bf16, bf16>)
+        //CPU_INSTANCE_X64(jit_uni_dw_convolution_fwd_t<avx512_core, bf16, bf16>)
+        //CPU_INSTANCE_X64(jit_avx512_core_bf16_1x1_convolution_fwd_t<bf16>)
         CPU_INSTANCE_X64(jit_avx512_core_bf16_convolution_fwd_t)
-        CPU_INSTANCE_X64(gemm_bf16_convolution_fwd_t<f32>)
-        CPU_INSTANCE(ref_convolution_fwd_t<bf16, bf16, f32, f32>)
+        //CPU_INSTANCE_X64(gemm_bf16_convolution_fwd_t<bf16>)
+        //CPU_INSTANCE(ref_convolution_fwd_t<bf16, bf16, bf16, f32>)
+        //CPU_INSTANCE(ref_fused_convolution_fwd_t)
         nullptr,
     }},
-    {{forward, bf16, bf16, bf16}, {
-        CPU_INSTANCE_X64(jit_avx512_core_amx_1x1_convolution_fwd_t<bf16, bf16, bf16>)
-        CPU_INSTANCE_X64(jit_avx512_core_amx_convolution_fwd_t<bf16, bf16, bf16>)
-        CPU_INSTANCE_X64(brgemm_1x1_convolution_fwd_t<avx512_core_bf16, bf16, bf16, bf16>)
-        CPU_INSTANCE_X64(brgemm_convolution_fwd_t<avx512_core_bf16, bf16, bf16, bf16>)
-        CPU_INSTANCE_X64(jit_uni_dw_convolution_fwd_t<avx512_core, bf16, bf16>)
-        CPU_INSTANCE_X64(jit_avx512_core_bf16_1x1_convolution_fwd_t<bf16>)
+    // FWD int8 (src:u8)
+    {{forward, u8, s8, f32}, {
+        //CPU_INSTANCE_X64(ip_convolution_fwd_t)
+        //CPU_INSTANCE_X64(jit_avx512_core_amx_1x1_convolution_fwd_t<u8, s8, f32>)
+        //CPU_INSTANCE_X64(jit_avx512_core_amx_convolution_fwd_t<u8, s8, f32>)
+        //CPU_INSTANCE_X64(brgemm_1x1_convolution_fwd_t<avx512_core_vnni, u8, s8, f32>)
+        //CPU_INSTANCE_X64(brgemm_convolution_fwd_t<avx512_core_vnni, u8, s8, f32>)
+        //CPU_INSTANCE_X64(jit_avx512_core_u8s8s32x_wino_convolution_fwd_t<f32>)
+        //CPU_INSTANCE_X64(jit_avx512_core_x8s8s32x_1x1_convolution_fwd_t<u8, f32>)
+        CPU_INSTANCE_X64(jit_avx512_core_x8s8s32x_convolution_fwd_t<u8, f32>)
+        //CPU_INSTANCE_X64(jit_uni_x8s8s32x_1x1_convolution_fwd_t<avx2, u8, f32>)
+        //CPU_INSTANCE_X64(jit_uni_x8s8s32x_convolution_fwd_t<avx2, u8, f32>)
+        //CPU_INSTANCE_X64(jit_uni_x8s8s32x_1x1_convolution_fwd_t<sse41, u8, f32>)
+        //CPU_INSTANCE_X64(jit_uni_x8s8s32x_convolution_fwd_t<sse41, u8, f32>)
+        //CPU_INSTANCE_AARCH64(jit_sve_512_x8s8s32x_convolution_fwd_t<u8, f32>)
+        //CPU_INSTANCE(_gemm_x8s8s32x_convolution_fwd_t<u8, f32>)
+        //CPU_INSTANCE(ref_convolution_fwd_t<u8, s8, f32, s32>)
+        nullptr,
+    }},
+    {{forward, u8, s8, u8}, {
+        //CPU_INSTANCE_X64(ip_convolution_fwd_t)
+        //CPU_INSTANCE_X64(jit_avx512_core_amx_1x1_convolution_fwd_t<u8, s8, u8>)
+        //CPU_INSTANCE_X64(jit_avx512_core_amx_convolution_fwd_t<u8, s8, u8>)
+        //CPU_INSTANCE_X64(brgemm_1x1_convolution_fwd_t<avx512_core_vnni, u8, s8, u8>)
+        //CPU_INSTANCE_X64(brgemm_convolution_fwd_t<avx512_core_vnni, u8, s8, u8>)
+        //CPU_INSTANCE_X64(jit_avx512_core_u8s8s32x_wino_convolution_fwd_t<u8>)
+        //CPU_INSTANCE_X64(jit_avx512_core_x8s8s32x_1x1_convolution_fwd_t<u8, u8>)
+        CPU_INSTANCE_X64(jit_avx512_core_x8s8s32x_convolution_fwd_t<u8, u8>)
+        //CPU_INSTANCE_X64(jit_uni_x8s8s32x_1x1_convolution_fwd_t<avx2, u8, u8>)
+        //CPU_INSTANCE_X64(jit_uni_x8s8s32x_convolution_fwd_t<avx2, u8, u8>)
+        //CPU_INSTANCE_X64(jit_uni_x8s8s32x_1x1_convolution_fwd_t<sse41, u8, u8>)
+        //CPU_INSTANCE_X64(jit_uni_x8s8s32x_convolution_fwd_t<sse41, u8, u8>)
+        //CPU_INSTANCE_AARCH64(jit_sve_512_x8s8s32x_convolution_fwd_t<u8, u8>)
+        //CPU_INSTANCE(_gemm_x8s8s32x_convolution_fwd_t<u8, u8>)
+        //CPU_INSTANCE(ref_convolution_fwd_t<u8, s8, u8, s32>)
+        //CPU_INSTANCE(ref_fused_convolution_fwd_t)
+        nullptr,
+    }},
+    {{forward, bf16, bf16, f32}, {
+        //CPU_INSTANCE_X64(jit_avx512_core_amx_1x1_convolution_fwd_t<bf16, bf16, f32>)
+        //CPU_INSTANCE_X64(jit_avx512_core_amx_convolution_fwd_t<bf16, bf16, f32>)
+        //CPU_INSTANCE_X64(brgemm_1x1_convolution_fwd_t<avx512_core_bf16, bf16, bf16, f32>)
+        //CPU_INSTANCE_X64(brgemm_convolution_fwd_t<avx512_core_bf16, bf16, bf16, f32>)
+        //CPU_INSTANCE_X64(jit_uni_dw_convolution_fwd_t<avx512_core, bf16, f32>)
+        //CPU_INSTANCE_X64(jit_avx512_core_bf16_1x1_convolution_fwd_t<f32>)
         CPU_INSTANCE_X64(jit_avx512_core_bf16_convolution_fwd_t)
-        CPU_INSTANCE_X64(gemm_bf16_convolution_fwd_t<bf16>)
-        CPU_INSTANCE(ref_convolution_fwd_t<bf16, bf16, bf16, f32>)
-        CPU_INSTANCE(ref_fused_convolution_fwd_t)
+        //CPU_INSTANCE_X64(gemm_bf16_convolution_fwd_t<f32>)
+        //CPU_INSTANCE(ref_convolution_fwd_t<bf16, bf16, f32, f32>)
         nullptr,
     }},
+    /*
     // BWD_D fp
     {{backward_data, f32, f32, f32}, {
         CPU_INSTANCE_X64(jit_avx512_common_dw_convolution_bwd_data_t)
@@ -288,24 +326,6 @@ const std::map<conv_impl_key_t, std::vector<pd_create_f>> impl_list_map {
         nullptr,
     }},
     // FWD int8 (src:u8)
-    {{forward, u8, s8, f32}, {
-        CPU_INSTANCE_X64(ip_convolution_fwd_t)
-        CPU_INSTANCE_X64(jit_avx512_core_amx_1x1_convolution_fwd_t<u8, s8, f32>)
-        CPU_INSTANCE_X64(jit_avx512_core_amx_convolution_fwd_t<u8, s8, f32>)
-        CPU_INSTANCE_X64(brgemm_1x1_convolution_fwd_t<avx512_core_vnni, u8, s8, f32>)
-        CPU_INSTANCE_X64(brgemm_convolution_fwd_t<avx512_core_vnni, u8, s8, f32>)
-        CPU_INSTANCE_X64(jit_avx512_core_u8s8s32x_wino_convolution_fwd_t<f32>)
-        CPU_INSTANCE_X64(jit_avx512_core_x8s8s32x_1x1_convolution_fwd_t<u8, f32>)
-        CPU_INSTANCE_X64(jit_avx512_core_x8s8s32x_convolution_fwd_t<u8, f32>)
-        CPU_INSTANCE_X64(jit_uni_x8s8s32x_1x1_convolution_fwd_t<avx2, u8, f32>)
-        CPU_INSTANCE_X64(jit_uni_x8s8s32x_convolution_fwd_t<avx2, u8, f32>)
-        CPU_INSTANCE_X64(jit_uni_x8s8s32x_1x1_convolution_fwd_t<sse41, u8, f32>)
-        CPU_INSTANCE_X64(jit_uni_x8s8s32x_convolution_fwd_t<sse41, u8, f32>)
-        CPU_INSTANCE_AARCH64(jit_sve_512_x8s8s32x_convolution_fwd_t<u8, f32>)
-        CPU_INSTANCE(_gemm_x8s8s32x_convolution_fwd_t<u8, f32>)
-        CPU_INSTANCE(ref_convolution_fwd_t<u8, s8, f32, s32>)
-        nullptr,
-    }},
     {{forward, u8, s8, s32}, {
         CPU_INSTANCE_X64(ip_convolution_fwd_t)
         CPU_INSTANCE_X64(jit_avx512_core_amx_1x1_convolution_fwd_t<u8, s8, s32>)
@@ -343,25 +363,6 @@ const std::map<conv_impl_key_t, std::vector<pd_create_f>> impl_list_map {
         CPU_INSTANCE(ref_fused_convolution_fwd_t)
         nullptr,
     }},
-    {{forward, u8, s8, u8}, {
-        CPU_INSTANCE_X64(ip_convolution_fwd_t)
-        CPU_INSTANCE_X64(jit_avx512_core_amx_1x1_convolution_fwd_t<u8, s8, u8>)
-        CPU_INSTANCE_X64(jit_avx512_core_amx_convolution_fwd_t<u8, s8, u8>)
-        CPU_INSTANCE_X64(brgemm_1x1_convolution_fwd_t<avx512_core_vnni, u8, s8, u8>)
-        CPU_INSTANCE_X64(brgemm_convolution_fwd_t<avx512_core_vnni, u8, s8, u8>)
-        CPU_INSTANCE_X64(jit_avx512_core_u8s8s32x_wino_convolution_fwd_t<u8>)
-        CPU_INSTANCE_X64(jit_avx512_core_x8s8s32x_1x1_convolution_fwd_t<u8, u8>)
-        CPU_INSTANCE_X64(jit_avx512_core_x8s8s32x_convolution_fwd_t<u8, u8>)
-        CPU_INSTANCE_X64(jit_uni_x8s8s32x_1x1_convolution_fwd_t<avx2, u8, u8>)
-        CPU_INSTANCE_X64(jit_uni_x8s8s32x_convolution_fwd_t<avx2, u8, u8>)
-        CPU_INSTANCE_X64(jit_uni_x8s8s32x_1x1_convolution_fwd_t<sse41, u8, u8>)
-        CPU_INSTANCE_X64(jit_uni_x8s8s32x_convolution_fwd_t<sse41, u8, u8>)
-        CPU_INSTANCE_AARCH64(jit_sve_512_x8s8s32x_convolution_fwd_t<u8, u8>)
-        CPU_INSTANCE(_gemm_x8s8s32x_convolution_fwd_t<u8, u8>)
-        CPU_INSTANCE(ref_convolution_fwd_t<u8, s8, u8, s32>)
-        CPU_INSTANCE(ref_fused_convolution_fwd_t)
-        nullptr,
-    }},
     // BWD int8 (diff_dst:u8)
     {{backward_data, f32, s8, u8}, {
         CPU_INSTANCE(_gemm_u8s8s32x_convolution_bwd_data_t<f32>)
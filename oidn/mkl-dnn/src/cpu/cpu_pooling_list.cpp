@@ -22,7 +22,7 @@
 #include "cpu/ref_pooling.hpp"
 
 #if DNNL_X64
-//#include "cpu/x64/jit_uni_i8i8_pooling.hpp"
+#include "cpu/x64/jit_uni_i8i8_pooling.hpp"
 #include "cpu/x64/jit_uni_pooling.hpp"
 using namespace dnnl::impl::cpu::x64;
 #elif DNNL_AARCH64
@@ -43,7 +43,7 @@ using namespace dnnl::impl::data_type;
 // clang-format off
 const pd_create_f impl_list[] = {
         /* fp */
-        //CPU_INSTANCE_X64(jit_uni_pooling_fwd_t<avx512_core, bf16>)
+        CPU_INSTANCE_X64(jit_uni_pooling_fwd_t<avx512_core, bf16>)
         //CPU_INSTANCE_X64(jit_uni_pooling_bwd_t<avx512_core, bf16>)
         CPU_INSTANCE_X64(jit_uni_pooling_fwd_t<avx512_core, f32>)
         //CPU_INSTANCE_X64(jit_uni_pooling_bwd_t<avx512_core, f32>)
@@ -72,8 +72,8 @@ const pd_create_f impl_list[] = {
         CPU_INSTANCE(ref_pooling_bwd_t<bf16>)
         */
         /* int */
-        /*
         CPU_INSTANCE_X64(jit_uni_i8i8_pooling_fwd_t<avx512_core>)
+        /*
         CPU_INSTANCE_X64(jit_uni_i8i8_pooling_fwd_t<avx2>)
         CPU_INSTANCE_X64(jit_uni_i8i8_pooling_fwd_t<sse41>)
         CPU_INSTANCE_AARCH64(jit_uni_i8i8_pooling_fwd_t<sve_512>)
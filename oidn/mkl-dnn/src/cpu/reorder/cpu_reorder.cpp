@@ -23,7 +23,7 @@ namespace cpu {
 
 /* regular reorders */
 std::map<reorder_impl_key_t, const void *> regular_impl_list_map {
-        //{{f32, bf16, 0}, &regular_f32_bf16_impl_list_map},
+        {{f32, bf16, 0}, &regular_f32_bf16_impl_list_map},
         //{{f32, f16, 0}, &regular_f32_f16_impl_list_map},
         {{f32, f32, 0}, &regular_f32_f32_impl_list_map},
         //{{f32, s32, 0}, &regular_f32_s32_impl_list_map},
@@ -32,7 +32,7 @@ std::map<reorder_impl_key_t, const void *> regular_impl_list_map {
         //{{bf16, data_type::undef, 0}, &regular_bf16_impl_list_map},
         //{{f16, data_type::undef, 0}, &regular_f16_impl_list_map},
         //{{s32, data_type::undef, 0}, &regular_s32_impl_list_map},
-        //{{s8, data_type::undef, 0}, &regular_s8_impl_list_map},
+        {{s8, data_type::undef, 0}, &regular_s8_impl_list_map},
         //{{u8, data_type::undef, 0}, &regular_u8_impl_list_map},
 };
 
@@ -25,6 +25,8 @@ namespace cpu {
 const impl_list_map_t regular_f32_f32_impl_list_map {
     // f32 -> f32
     {{f32, f32, 0}, {
+        DNNL_X64_ONLY(x64::wino_reorder_t<f32, f32>::pd_t::create,)
+
         REG_FAST_DIRECT_COPY_F32_F32_COMMA
 
         DNNL_X64_ONLY(x64::jit_uni_reorder_create,)
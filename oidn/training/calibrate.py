@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+
+## Copyright 2018-2021 Intel Corporation
+## SPDX-License-Identifier: Apache-2.0
+
+import os
+import torch
+import torch.nn as nn
+
+from config import *
+from util import *
+from dataset import *
+from color import *
+from result import *
+from infer import Infer
+
+# Tensors concatenated by the network, which must share the same quantization scale
+CONCAT_GROUPS = [
+  ('enc_conv5b', 'enc_conv3'),  # concat4 (pool3 keeps the scale of enc_conv3)
+  ('dec_conv4b', 'enc_conv2'),  # concat3
+  ('dec_conv3b', 'enc_conv1'),  # concat2
+  ('dec_conv2b', 'input')       # concat1
+]
+
+# Returns the calibration filename in a result directory
+def get_calibration_filename(result_dir):
+  return os.path.join(result_dir, 'calibration.json')
+
+# Loads the calibrated activation scales of a result
+def load_calibration(result_dir):
+  filename = get_calibration_filename(result_dir)
+  if not os.path.isfile(filename):
+    error('calibration does not exist, run calibrate.py first')
+  return load_json(filename)
+
+# Returns the range of a tensor (percentile of its values)
+def get_range(x, percentile):
+  x = x.detach().float().flatten()
+  if percentile >= 100.:
+    return x.max().item()
+  k = max(int(round(x.numel() * percentile / 100.)), 1)
+  return x.kthvalue(k).values.item()
+
+def main():
+  # Parse the command line arguments
+  cfg = parse_args(description='Calibrates the activation ranges of a training result for int8 inference.')
+  if not (0. < cfg.percentile <= 100.):
+    error('invalid percentile')
+
+  # Initialize the PyTorch device
+  device = init_device(cfg)
+
+  # Initialize the inference function
+  infer = Infer(cfg, device)
+  print('Result:', cfg.result)
+  print('Epoch:', infer.epoch)
+
+  # Record the ranges of the network input and of the (ReLU) outputs of the convolutions
+  ranges = {}
+  def update_range(name, x):
+    ranges[name] = max(ranges.get(name, 0.), get_range(torch.relu(x), cfg.percentile))
+
+  hooks = [infer.model.register_forward_pre_hook(lambda module, input: update_range('input', input[0]))]
+  for name, module in infer.model.named_modules():
+    if isinstance(module, nn.Conv2d) and name != 'dec_conv0':
+      hooks.append(module.register_forward_hook(
+        lambda module, input, output, name=name: update_range(name, output)))
+
+  # Initialize the dataset
+  data_dir = get_data_dir(cfg, cfg.input_data)
+  image_sample_groups = get_image_sample_groups(data_dir, infer.features)
+
+  # Iterate over the images
+  print()
+  num_images = 0
+  with torch.no_grad():
+    for group, input_names, _ in image_sample_groups:
+      for input_name in input_names:
+        print(input_name)
+
+        # Load the input image
+        input = load_image_features(os.path.join(data_dir, input_name), infer.features)
+
+        # Compute the autoexposure value
+        exposure = autoexposure(input) if infer.main_feature == 'hdr' else 1.
+
+        # Infer
+        input = image_to_tensor(input, batch=True).to(device)
+        infer(input, exposure)
+        num_images += 1
+
+  for hook in hooks:
+    hook.remove()
+  if num_images == 0:
+    error('no images found for calibration')
+
+  # Concatenated tensors must have the same range
+  for group in CONCAT_GROUPS:
+    value = max(ranges[name] for name in group)
+    for name in group:
+      ranges[name] = value
+
+  # Save the scales of the u8 activations
+  scales = {name : (value / 255. if value > 0. else 1.) for name, value in ranges.items()}
+  result_dir = get_result_dir(cfg)
+  filename = get_calibration_filename(result_dir)
+  save_json(filename, {'epoch' : infer.epoch, 'percentile' : cfg.percentile, 'scales' : scales})
+
+  print()
+  for name, value in ranges.items():
+    print(f'{name}: range={value:.4f}')
+  print('Output:', filename)
+
+if __name__ == '__main__':
+  main()
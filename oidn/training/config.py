@@ -74,21 +74,21 @@ def parse_args(cmd=None, description=None):
     parser.add_argument('--valid_data', '-v', type=str,
                         help='name of the validation dataset')
 
-  if cmd in {'preprocess', 'infer'}:
+  if cmd in {'preprocess', 'infer', 'calibrate'}:
     parser.add_argument('--data_dir', '-D', type=str, default='data',
                         help='directory of datasets (e.g. training, validation, test)')
 
-  if cmd in {'train', 'find_lr', 'infer', 'export', 'visualize'}:
+  if cmd in {'train', 'find_lr', 'infer', 'calibrate', 'export', 'visualize'}:
     parser.add_argument('--results_dir', '-R', type=str, default='results',
                         help='directory of training results')
     parser.add_argument('--result', '-r', type=str, required=(not cmd in {'train', 'find_lr'}),
                         help='name of the training result')
 
-  if cmd in {'infer'}:
+  if cmd in {'infer', 'calibrate'}:
     parser.add_argument('--aux_results', '-a', type=str, nargs='*', default=[],
                         help='prefilter auxiliary features using the specified training results')
 
-  if cmd in {'train', 'infer', 'export'}:
+  if cmd in {'train', 'infer', 'calibrate', 'export'}:
     parser.add_argument('--num_epochs', '--epochs', '-e', type=int,
                         default=(2000 if cmd == 'train' else None),
                         help='number of training epochs')
@@ -136,9 +136,11 @@ def parse_args(cmd=None, description=None):
                         choices=['psnr', 'mse', 'ssim', 'msssim'], default=['psnr', 'ssim'],
                         help='metrics to compute')
 
-  if cmd in {'infer'}:
+  if cmd in {'infer', 'calibrate'}:
     parser.add_argument('--input_data', '-i', type=str, default='test',
                         help='name of the input dataset')
+
+  if cmd in {'infer'}:
     parser.add_argument('--output_dir', '-O', type=str, default='infer',
                         help='directory of output images')
     parser.add_argument('--output_suffix', '-o', type=str,
@@ -154,6 +156,12 @@ def parse_args(cmd=None, description=None):
                         help='what to export')
     parser.add_argument('--output', '-o', type=str,
                         help='output file')
+    parser.add_argument('--int8', action='store_true',
+                        help='export 8-bit integer weights with the calibrated quantization scales')
+
+  if cmd in {'calibrate'}:
+    parser.add_argument('--percentile', type=float, default=100.,
+                        help='percentile of the activation values used as their range (100 is the maximum)')
 
   if cmd in {'convert_image', 'split_exr'}:
     parser.add_argument('input', type=str,
@@ -175,7 +183,7 @@ def parse_args(cmd=None, description=None):
     parser.add_argument('--layer', type=str,
                         help='name of the image layer')
 
-  if cmd in {'preprocess', 'train', 'find_lr', 'infer', 'export'}:
+  if cmd in {'preprocess', 'train', 'find_lr', 'infer', 'calibrate', 'export'}:
     parser.add_argument('--device', '-d', type=str,
                         choices=['cpu', 'cuda'], default=get_default_device(),
                         help='type of device(s) to use')
@@ -184,7 +192,7 @@ def parse_args(cmd=None, description=None):
     parser.add_argument('--num_devices', '-n', type=int, default=1,
                         help='number of devices to use (with IDs device_id .. device_id+num_devices-1)')
     advanced.add_argument('--deterministic', '--det', action='store_true',
-                          default=(cmd in {'preprocess', 'infer', 'export'}),
+                          default=(cmd in {'preprocess', 'infer', 'calibrate', 'export'}),
                           help='makes computations deterministic (slower performance)')
 
   cfg = parser.parse_args()
@@ -12,6 +12,7 @@ from config import *
 from util import *
 from result import *
 import tza
+from calibrate import load_calibration
 
 def main():
   # Parse the command line arguments
@@ -38,6 +39,13 @@ def export_weights(cfg):
   model_state = checkpoint['model_state']
   print('Epoch:', epoch)
 
+  # Load the activation scales for int8 export
+  if cfg.int8:
+    calibration = load_calibration(result_dir)
+    if calibration['epoch'] != epoch:
+      warning('calibration was performed for a different epoch')
+    activation_scales = calibration['scales']
+
   # Save the weights to a TZA file
   if cfg.output:
     output_filename = cfg.output
@@ -61,8 +69,20 @@ def export_weights(cfg):
       else:
         error('unknown state value')
 
+      if cfg.int8 and layout == 'oihw':
+        # Quantize the weights symmetrically per output channel
+        max_abs = np.abs(tensor.reshape(tensor.shape[0], -1)).max(axis=1)
+        weight_scale = np.where(max_abs > 0., max_abs / 127., 1.).astype(np.float32)
+        tensor = np.clip(np.rint(tensor / weight_scale.reshape(-1, 1, 1, 1)), -127, 127).astype(np.int8)
+        output_file.write(name + '_scale', weight_scale, 'x')
+
       output_file.write(name, tensor, layout)
 
+    # Save the scales of the u8 activations
+    if cfg.int8:
+      for name, scale in activation_scales.items():
+        output_file.write(name + '.output_scale', np.array([scale], dtype=np.float32), 'x')
+
 # Exports the result directory to a ZIP file
 def export_package(cfg):
   # Get the output filename
@@ -0,0 +1,444 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+// Benchmark of the lightmap denoiser on a synthetic corpus. Noisy HDR lightmaps
+// are generated for every combination of size and chart coverage, then both the
+// bare OIDN filter and the full load -> denoise -> save pipeline of the command
+// line tool are timed. The results are written as JSON.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <OpenImageDenoise/oidn.h>
+#include "defaultlightmapdenoiser.h"
+#include "tinyexr.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    int iterations = 10;
+    std::vector<int> sizes = { 256, 512, 1024, 2048 };
+    std::vector<double> densities = { 0.3, 0.7 };
+    int files = 4;
+    int jobs = 1;
+    bool half = false;
+    bool mask = true;
+    bool stream = false;
+    std::string output;
+};
+
+// Interleaved RGBA float lightmap, alpha is 1 inside the charts and 0 elsewhere
+struct Lightmap {
+    int width = 0;
+    int height = 0;
+    std::vector<float> pixels;
+    double coverage = 0; // fraction of the texels inside charts
+};
+
+// Generates a lightmap of rectangular charts packed in shelves. Each slot is
+// filled with a chart with the given probability, so 'density' roughly sets the
+// coverage. The charts have smooth lighting with a hard shadow edge, rendered
+// with Monte Carlo noise of 16 samples per texel and occasional fireflies.
+static Lightmap generateLightmap(int size, double density, uint32_t seed)
+{
+    Lightmap lightmap;
+    lightmap.width = size;
+    lightmap.height = size;
+    lightmap.pixels.assign(size_t(size) * size * 4, 0.0f);
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::gamma_distribution<float> estimate(16.0f, 1.0f / 16.0f); // mean of 16 exponential samples
+    const int gutter = 2;
+    const int minChart = std::max(size / 32, 4);
+    const int maxChart = std::max(size / 4, minChart + 1);
+    std::uniform_int_distribution<int> chartSize(minChart, maxChart);
+
+    size_t covered = 0;
+    for (int y = gutter; y < size - gutter;) {
+        const int shelfH = std::min(chartSize(rng), size - gutter - y);
+        for (int x = gutter; x < size - gutter;) {
+            const int chartW = std::min(chartSize(rng), size - gutter - x);
+            const int chartH = std::max(shelfH - int(uniform(rng) * shelfH / 2), 1);
+            if (uniform(rng) < density) {
+                const float albedo[3] = { 0.3f + 0.7f * uniform(rng), 0.3f + 0.7f * uniform(rng), 0.3f + 0.7f * uniform(rng) };
+                const float intensity = 0.5f + 8.0f * uniform(rng) * uniform(rng);
+                const float freqU = 1.0f + 6.0f * uniform(rng), freqV = 1.0f + 6.0f * uniform(rng);
+                const float phase = 6.2832f * uniform(rng);
+                const float shadowA = uniform(rng) - 0.5f, shadowB = uniform(rng) - 0.5f;
+                for (int cy = 0; cy < chartH; ++cy) {
+                    for (int cx = 0; cx < chartW; ++cx) {
+                        const float u = float(cx) / chartW, v = float(cy) / chartH;
+                        float irradiance = intensity * (0.6f + 0.4f * std::sin(freqU * u + phase) * std::cos(freqV * v));
+                        if (shadowA * (u - 0.5f) + shadowB * (v - 0.5f) > 0.0f)
+                            irradiance *= 0.15f;
+                        float noise = estimate(rng);
+                        if (uniform(rng) < 5e-4f)
+                            noise *= 20.0f + 80.0f * uniform(rng);
+                        float *pixel = &lightmap.pixels[(size_t(y + cy) * size + (x + cx)) * 4];
+                        for (int c = 0; c < 3; ++c)
+                            pixel[c] = albedo[c] * irradiance * noise;
+                        pixel[3] = 1.0f;
+                    }
+                }
+                covered += size_t(chartW) * chartH;
+            }
+            x += chartW + gutter;
+        }
+        y += shelfH + gutter;
+    }
+
+    lightmap.coverage = double(covered) / (double(size) * size);
+    return lightmap;
+}
+
+static double peakRSSMegabytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+    return usage.ru_maxrss / 1024.0; // kilobytes
+#endif
+#endif
+}
+
+// Latencies in milliseconds of the timed iterations
+struct Latencies {
+    std::vector<double> values;
+
+    double percentile(double p) const
+    {
+        if (values.empty())
+            return 0;
+        std::vector<double> sorted = values;
+        std::sort(sorted.begin(), sorted.end());
+        const size_t rank = size_t(std::ceil(p / 100.0 * sorted.size()));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    double mean() const
+    {
+        double sum = 0;
+        for (double value : values)
+            sum += value;
+        return values.empty() ? 0 : sum / values.size();
+    }
+};
+
+static double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static bool checkError(OIDNDevice device)
+{
+    const char *msg;
+    if (oidnGetDeviceError(device, &msg) != OIDN_ERROR_NONE) {
+        std::cerr << "Error from denoiser: " << msg << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Denoises the lightmap in place the way the command line tool does, restoring
+// the noisy pixels before every iteration
+static bool benchFilter(OIDNDevice device, const Lightmap &lightmap, const Options &options, std::ostream &json)
+{
+    std::vector<float> pixels = lightmap.pixels;
+    const size_t pixelStride = 4 * sizeof(float);
+
+    const auto commitStart = Clock::now();
+    OIDNFilter filter = oidnNewFilter(device, "RTLightmap");
+    oidnSetFilter1b(filter, "hdr", true);
+    oidnSetSharedFilterImage(filter, "color", pixels.data(), OIDN_FORMAT_FLOAT3, lightmap.width, lightmap.height, 0, pixelStride, 0);
+    oidnSetSharedFilterImage(filter, "output", pixels.data(), OIDN_FORMAT_FLOAT3, lightmap.width, lightmap.height, 0, pixelStride, 0);
+    if (options.mask)
+        oidnSetSharedFilterImage(filter, "mask", pixels.data() + 3, OIDN_FORMAT_FLOAT, lightmap.width, lightmap.height, 0, pixelStride, 0);
+    oidnCommitFilter(filter);
+    const double commitTime = millisecondsSince(commitStart);
+
+    // Warm-up
+    oidnExecuteFilter(filter);
+    bool ok = checkError(device);
+
+    Latencies latencies;
+    for (int i = 0; ok && i < options.iterations; ++i) {
+        pixels = lightmap.pixels;
+        const auto start = Clock::now();
+        oidnExecuteFilter(filter);
+        latencies.values.push_back(millisecondsSince(start));
+        ok = checkError(device);
+    }
+    oidnReleaseFilter(filter);
+    if (!ok)
+        return false;
+
+    const double numPixels = double(lightmap.width) * lightmap.height;
+    json << "\"filter\": {"
+         << "\"commit_ms\": " << commitTime
+         << ", \"mean_ms\": " << latencies.mean()
+         << ", \"p50_ms\": " << latencies.percentile(50)
+         << ", \"p99_ms\": " << latencies.percentile(99)
+         << ", \"mpix_per_s\": " << numPixels / (latencies.mean() * 1e3)
+         << "}";
+    return true;
+}
+
+static bool readFile(const fs::path &path, std::string &data)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static bool writeFile(const fs::path &path, const std::string &data)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), std::streamsize(data.size()));
+    return bool(file);
+}
+
+// Runs the list file pipeline over copies of the lightmap with different noise.
+// The files are replaced by the denoised ones, so the noisy files are restored
+// before every iteration.
+static bool benchPipeline(DefaultLightmapDenoiser &denoiser, int size, double density, const fs::path &dir,
+                          const Options &options, std::ostream &json)
+{
+    std::vector<std::pair<fs::path, std::string>> files;
+    std::ofstream list(dir / "qlm_list.txt", std::ios::trunc);
+    for (int i = 0; i < options.files; ++i) {
+        const Lightmap lightmap = generateLightmap(size, density, uint32_t(size * 7919 + i));
+        const fs::path path = dir / ("qlm_bench_" + std::to_string(i) + ".exr");
+        const char *err = nullptr;
+        if (SaveEXR(lightmap.pixels.data(), lightmap.width, lightmap.height, 4, 0, path.string().c_str(), &err) < 0) {
+            std::cerr << "Failed to write " << path.string() << ": " << (err ? err : "unknown error") << "\n";
+            FreeEXRErrorMessage(err);
+            return false;
+        }
+        std::string data;
+        if (!readFile(path, data))
+            return false;
+        files.emplace_back(path, std::move(data));
+        list << path.string() << "\n";
+    }
+    list.close();
+
+    const std::string listFile = (dir / "qlm_list.txt").string();
+    Latencies latencies;
+    DefaultLightmapDenoiser::Statistics stages;
+    for (int i = 0; i <= options.iterations; ++i) {
+        for (const auto &file : files) {
+            if (!writeFile(file.first, file.second))
+                return false;
+        }
+
+        denoiser.resetStatistics();
+        const auto start = Clock::now();
+        if (!denoiser.process(listFile))
+            return false;
+        if (i == 0)
+            continue; // warm-up, commits the filters
+
+        latencies.values.push_back(millisecondsSince(start));
+        const DefaultLightmapDenoiser::Statistics stats = denoiser.statistics();
+        stages.numImages += stats.numImages;
+        stages.numPixels += stats.numPixels;
+        stages.loadSeconds += stats.loadSeconds;
+        stages.denoiseSeconds += stats.denoiseSeconds;
+        stages.saveSeconds += stats.saveSeconds;
+    }
+
+    const double iterations = std::max(options.iterations, 1);
+    const double numPixels = double(stages.numPixels) / iterations;
+    json << "\"pipeline\": {"
+         << "\"files\": " << options.files
+         << ", \"mean_ms\": " << latencies.mean()
+         << ", \"p50_ms\": " << latencies.percentile(50)
+         << ", \"p99_ms\": " << latencies.percentile(99)
+         << ", \"mpix_per_s\": " << numPixels / (latencies.mean() * 1e3)
+         << ", \"stages_ms\": {"
+         << "\"load\": " << stages.loadSeconds * 1e3 / iterations
+         << ", \"denoise\": " << stages.denoiseSeconds * 1e3 / iterations
+         << ", \"save\": " << stages.saveSeconds * 1e3 / iterations
+         << "}}";
+    return true;
+}
+
+template<typename T>
+static bool parseList(const std::string &arg, std::vector<T> &values)
+{
+    values.clear();
+    std::stringstream stream(arg);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        std::stringstream itemStream(item);
+        T value;
+        if (!(itemStream >> value) || value <= 0)
+            return false;
+        values.push_back(value);
+    }
+    return !values.empty();
+}
+
+static void showHelp(const std::string &appName)
+{
+    std::cout << "Usage: " << appName << " [options]\n";
+    std::cout << "Options:\n";
+    std::cout << "  -h, --help              Show this help message\n";
+    std::cout << "  -n, --iterations <n>    Timed iterations per case (default: 10)\n";
+    std::cout << "  -s, --sizes <list>      Comma separated lightmap sizes (default: 256,512,1024,2048)\n";
+    std::cout << "  -d, --densities <list>  Comma separated chart coverages in (0, 1] (default: 0.3,0.7)\n";
+    std::cout << "  -f, --files <n>         Files in the list denoised by the pipeline (default: 4)\n";
+    std::cout << "  -j, --jobs <n|auto>     Files of the list denoised concurrently (default: 1)\n";
+    std::cout << "      --half              Keep pixels as fp16 in the pipeline\n";
+    std::cout << "      --no-mask           Denoise the texels outside the charts too\n";
+    std::cout << "      --stream            Denoise the files of the pipeline in bands of rows\n";
+    std::cout << "  -o, --output <file>     Write the JSON results to a file instead of stdout\n";
+}
+
+int main(int argc, char **argv)
+{
+    const std::string appName = argv[0];
+    Options options;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        bool ok = true;
+        if (arg == "-h" || arg == "--help") {
+            showHelp(appName);
+            return EXIT_SUCCESS;
+        } else if ((arg == "-n" || arg == "--iterations") && hasValue) {
+            options.iterations = std::max(std::atoi(argv[++i]), 1);
+        } else if ((arg == "-s" || arg == "--sizes") && hasValue) {
+            ok = parseList(argv[++i], options.sizes);
+        } else if ((arg == "-d" || arg == "--densities") && hasValue) {
+            ok = parseList(argv[++i], options.densities);
+        } else if ((arg == "-f" || arg == "--files") && hasValue) {
+            options.files = std::max(std::atoi(argv[++i]), 1);
+        } else if ((arg == "-j" || arg == "--jobs") && hasValue) {
+            const std::string jobs = argv[++i];
+            options.jobs = jobs == "auto" ? 0 : std::max(std::atoi(jobs.c_str()), 1);
+        } else if (arg == "--half") {
+            options.half = true;
+        } else if (arg == "--no-mask") {
+            options.mask = false;
+        } else if (arg == "--stream") {
+            options.stream = true;
+        } else if ((arg == "-o" || arg == "--output") && hasValue) {
+            options.output = argv[++i];
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            showHelp(appName);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::error_code error;
+#ifdef _WIN32
+    const fs::path dir = fs::temp_directory_path() / ("qlmbench-" + std::to_string(GetCurrentProcessId()));
+#else
+    const fs::path dir = fs::temp_directory_path() / ("qlmbench-" + std::to_string(getpid()));
+#endif
+    fs::create_directories(dir, error);
+    if (error) {
+        std::cerr << "Cannot create directory " << dir.string() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    OIDNDevice device = oidnNewDevice(OIDN_DEVICE_TYPE_CPU);
+    oidnCommitDevice(device);
+
+    DefaultLightmapDenoiser denoiser;
+    denoiser.setQuiet(true);
+    denoiser.setJobs(options.jobs);
+    denoiser.setHalf(options.half);
+    denoiser.setUseMask(options.mask);
+    denoiser.setStreaming(options.stream);
+
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"oidn_version\": \"" << OIDN_VERSION_MAJOR << "." << OIDN_VERSION_MINOR << "." << OIDN_VERSION_PATCH << "\",\n"
+         << "  \"threads\": " << oidnGetDevice1i(device, "numThreads") << ",\n"
+         << "  \"iterations\": " << options.iterations << ",\n"
+         << "  \"half\": " << (options.half ? "true" : "false") << ",\n"
+         << "  \"mask\": " << (options.mask ? "true" : "false") << ",\n"
+         << "  \"stream\": " << (options.stream ? "true" : "false") << ",\n"
+         << "  \"cases\": [";
+
+    bool ok = true;
+    bool first = true;
+    for (int size : options.sizes) {
+        for (double density : options.densities) {
+            std::cerr << "Benchmarking " << size << "x" << size << " with density " << density << std::endl;
+            const Lightmap lightmap = generateLightmap(size, density, uint32_t(size));
+            json << (first ? "\n" : ",\n")
+                 << "    {\"width\": " << lightmap.width << ", \"height\": " << lightmap.height
+                 << ", \"density\": " << density << ", \"coverage\": " << lightmap.coverage << ",\n      ";
+            first = false;
+            ok = benchFilter(device, lightmap, options, json);
+            json << ",\n      ";
+            ok = ok && benchPipeline(denoiser, size, density, dir, options, json);
+            // Process-wide high-water mark, so it includes the previous cases
+            json << ",\n      \"peak_rss_mb\": " << peakRSSMegabytes() << "}";
+            if (!ok)
+                break;
+        }
+        if (!ok)
+            break;
+    }
+    json << "\n  ]\n}\n";
+
+    oidnReleaseDevice(device);
+    fs::remove_all(dir, error);
+    if (!ok)
+        return EXIT_FAILURE;
+
+    if (options.output.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream file(options.output, std::ios::trunc);
+        file << json.str();
+        if (!file) {
+            std::cerr << "Cannot write " << options.output << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -109,6 +109,12 @@ extern "C" {
 #define TINYEXR_USE_MINIZ (1)
 #endif
 
+// Deflate level (0-9, -1 for the library default) used for ZIP/ZIPS
+// compression. May expand to a runtime expression.
+#ifndef TINYEXR_ZIP_COMPRESSION_LEVEL
+#define TINYEXR_ZIP_COMPRESSION_LEVEL (-1)
+#endif
+
 // Disable PIZ comporession when applying cpplint.
 #ifndef TINYEXR_USE_PIZ
 #define TINYEXR_USE_PIZ (1)
@@ -1266,17 +1272,17 @@ static void CompressZip(unsigned char *dst,
   //
 
   mz_ulong outSize = mz_compressBound(src_size);
-  int ret = mz_compress(
+  int ret = mz_compress2(
       dst, &outSize, static_cast<const unsigned char *>(&tmpBuf.at(0)),
-      src_size);
+      src_size, TINYEXR_ZIP_COMPRESSION_LEVEL);
   assert(ret == MZ_OK);
   (void)ret;
 
   compressedSize = outSize;
 #else
   uLong outSize = compressBound(static_cast<uLong>(src_size));
-  int ret = compress(dst, &outSize, static_cast<const Bytef *>(&tmpBuf.at(0)),
-                     src_size);
+  int ret = compress2(dst, &outSize, static_cast<const Bytef *>(&tmpBuf.at(0)),
+                      src_size, TINYEXR_ZIP_COMPRESSION_LEVEL);
   assert(ret == Z_OK);
   (void)ret;
 